@@ -0,0 +1,264 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Benchmark runner of `make bench`.
+//
+// Each case of the case file is a line "name arguments...": the solver is run
+// with these arguments plus --stats, its standard output going to /dev/null.
+// Every case is run several times and the median wall time is kept, with the
+// number of search nodes printed by --stats and the peak resident memory of
+// the process. The results are written as JSON, one case per line, and
+// compared with the results of a baseline file in the same format.
+
+#define MAX_CASES 256
+#define MAX_ARGS 32
+#define MAX_LINE 1024
+#define NAME_SIZE 64
+
+typedef struct {
+  char name[NAME_SIZE];
+  char *args[MAX_ARGS]; // Arguments of the solver, NULL terminated
+  double wall;          // Median wall time in seconds
+  unsigned long long nodes;
+  long peak_rss_kb;
+} t_case;
+
+typedef struct {
+  char name[NAME_SIZE];
+  double wall;
+} t_baseline;
+
+static void usage(void) {
+  fprintf(stderr, "Usage: bench [-r RUNS] [-b BASELINE] [-o RESULTS] SOLVER "
+                  "CASES\n");
+  exit(EXIT_FAILURE);
+}
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Read the cases, one per line, skipping blank and comment lines
+static int read_cases(const char *filename, t_case *cases) {
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    fprintf(stderr, "bench: cannot open '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  char line[MAX_LINE];
+  int count = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char *word = strtok(line, " \t\r\n");
+    if (word == NULL || word[0] == '#') {
+      continue;
+    }
+    if (count == MAX_CASES) {
+      fprintf(stderr, "bench: too many cases in '%s'\n", filename);
+      exit(EXIT_FAILURE);
+    }
+    t_case *c = &cases[count++];
+    snprintf(c->name, NAME_SIZE, "%s", word);
+    int nb_args = 1; // args[0] is the solver
+    while ((word = strtok(NULL, " \t\r\n")) != NULL) {
+      if (nb_args == MAX_ARGS - 2) {
+        fprintf(stderr, "bench: too many arguments for '%s'\n", c->name);
+        exit(EXIT_FAILURE);
+      }
+      c->args[nb_args++] = strdup(word);
+    }
+    c->args[nb_args++] = "--stats";
+    c->args[nb_args] = NULL;
+  }
+  fclose(file);
+  return count;
+}
+
+// Run the solver once. Returns the wall time, the nodes and the peak memory
+// are those reported for this run.
+static double run_once(t_case *c, unsigned long long *nodes, long *rss_kb) {
+  FILE *errors = tmpfile();
+  if (errors == NULL) {
+    fprintf(stderr, "bench: cannot create a temporary file\n");
+    exit(EXIT_FAILURE);
+  }
+  double start = now();
+  pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "bench: fork failed: %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    dup2(fileno(errors), STDERR_FILENO);
+    execv(c->args[0], c->args);
+    _exit(127);
+  }
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    fprintf(stderr, "bench: wait failed: %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  double wall = now() - start;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+    fprintf(stderr, "bench: case '%s' did not run\n", c->name);
+    exit(EXIT_FAILURE);
+  }
+  *rss_kb = usage.ru_maxrss;
+
+  // The last line with the node count wins
+  char line[MAX_LINE];
+  *nodes = 0;
+  rewind(errors);
+  while (fgets(line, sizeof(line), errors) != NULL) {
+    sscanf(line, "Search nodes: %llu", nodes);
+  }
+  fclose(errors);
+  return wall;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void run_case(t_case *c, int runs) {
+  double walls[runs];
+  c->peak_rss_kb = 0;
+  for (int r = 0; r < runs; r++) {
+    long rss_kb;
+    walls[r] = run_once(c, &c->nodes, &rss_kb);
+    if (rss_kb > c->peak_rss_kb) {
+      c->peak_rss_kb = rss_kb;
+    }
+  }
+  qsort(walls, runs, sizeof(double), compare_doubles);
+  c->wall = walls[runs / 2];
+}
+
+static void write_results(FILE *output, t_case *cases, int count, int runs) {
+  fprintf(output, "{\n  \"runs\": %d,\n  \"cases\": [\n", runs);
+  for (int k = 0; k < count; k++) {
+    t_case *c = &cases[k];
+    fprintf(output,
+            "    {\"name\": \"%s\", \"wall_s\": %.6f, \"nodes\": %llu, "
+            "\"nodes_per_s\": %.0f, \"peak_rss_kb\": %ld}%s\n",
+            c->name, c->wall, c->nodes,
+            c->wall > 0 ? c->nodes / c->wall : 0.0, c->peak_rss_kb,
+            k + 1 < count ? "," : "");
+  }
+  fprintf(output, "  ]\n}\n");
+}
+
+// Read the wall times of a results file, as written by write_results
+static int read_baseline(const char *filename, t_baseline *baseline) {
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    fprintf(stderr, "bench: no baseline '%s', nothing to compare with\n",
+            filename);
+    return 0;
+  }
+  char line[MAX_LINE];
+  int count = 0;
+  while (count < MAX_CASES && fgets(line, sizeof(line), file) != NULL) {
+    t_baseline *b = &baseline[count];
+    if (sscanf(line, " {\"name\": \"%63[^\"]\", \"wall_s\": %lf", b->name,
+               &b->wall) == 2) {
+      count++;
+    }
+  }
+  fclose(file);
+  return count;
+}
+
+static void compare(t_case *cases, int count, t_baseline *baseline,
+                    int nb_baseline) {
+  printf("%-24s %12s %12s %8s %14s %10s\n", "case", "wall (s)", "baseline",
+         "ratio", "nodes/s", "rss (KB)");
+  for (int k = 0; k < count; k++) {
+    t_case *c = &cases[k];
+    const t_baseline *b = NULL;
+    for (int i = 0; i < nb_baseline && b == NULL; i++) {
+      if (strcmp(baseline[i].name, c->name) == 0) {
+        b = &baseline[i];
+      }
+    }
+    printf("%-24s %12.6f", c->name, c->wall);
+    if (b != NULL && b->wall > 0) {
+      printf(" %12.6f %7.2fx", b->wall, c->wall / b->wall);
+    } else {
+      printf(" %12s %8s", "-", "-");
+    }
+    printf(" %14.0f %10ld\n", c->wall > 0 ? c->nodes / c->wall : 0.0,
+           c->peak_rss_kb);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int runs = 3;
+  const char *baseline_file = NULL;
+  const char *results_file = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:b:o:")) != -1) {
+    switch (opt) {
+    case 'r':
+      runs = atoi(optarg);
+      if (runs < 1) {
+        usage();
+      }
+      break;
+    case 'b':
+      baseline_file = optarg;
+      break;
+    case 'o':
+      results_file = optarg;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (argc - optind != 2) {
+    usage();
+  }
+
+  static t_case cases[MAX_CASES];
+  int count = read_cases(argv[optind + 1], cases);
+  for (int k = 0; k < count; k++) {
+    cases[k].args[0] = argv[optind];
+    fprintf(stderr, "bench: %s\n", cases[k].name);
+    run_case(&cases[k], runs);
+  }
+
+  if (results_file != NULL) {
+    FILE *output = fopen(results_file, "w");
+    if (output == NULL) {
+      fprintf(stderr, "bench: cannot open '%s'\n", results_file);
+      exit(EXIT_FAILURE);
+    }
+    write_results(output, cases, count, runs);
+    fclose(output);
+  } else {
+    write_results(stdout, cases, count, runs);
+  }
+
+  if (baseline_file != NULL) {
+    static t_baseline baseline[MAX_CASES];
+    int nb_baseline = read_baseline(baseline_file, baseline);
+    compare(cases, count, baseline, nb_baseline);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,21 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include "grid.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct {
+  int jobs;        // Number of solver threads, one per core when 0
+  t_engine engine; // Engine of the first solution search
+  bool count;      // Count the solutions instead of printing the first one
+  int limit;       // Cap of the count, 0 for no cap
+} t_batch_options;
+
+// Solve every grid of a file ("-" for the standard input) holding several of
+// them, separated by blank lines or comment lines. The grids are solved by a
+// pool of threads and the results are written to output in the order of the
+// input. Returns the number of grids which could not be read.
+int grid_solver_batch(const char *filename, FILE *output,
+                      const t_batch_options *options);
+
+#endif /* BATCH_H */
@@ -0,0 +1,34 @@
+#ifndef BINFORMAT_H
+#define BINFORMAT_H
+#include "utility.h"
+#include "writer.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Binary format of a stream of solutions (--format=bin).
+//
+// The file starts with the magic "TKZB" and one byte holding the size n of
+// the grids. Each solution follows as a delta from the previous one (from an
+// all zero grid for the first one): a mask of ceil(n / 8) bytes with bit i
+// set when row i changed, then the new value of each changed row, in ceil(n /
+// 8) bytes. Bit j of a row is the cell of column j, bytes are little endian.
+// Solutions found one after the other by the depth first search share most of
+// their rows, so a solution usually takes a few bytes.
+
+#define BIN_MAGIC "TKZB"
+
+typedef struct {
+  t_writer *writer;
+  int size;
+  uint64_t previous[64]; // Rows of the last solution written
+} t_bin_encoder;
+
+// Write the header of the stream
+void bin_encoder_init(t_bin_encoder *encoder, t_writer *writer, int size);
+void bin_encode_solution(t_bin_encoder *encoder, const t_grid *grid);
+// Write the solutions of a binary stream as text, in the format of the
+// search of all solutions. Returns the number of solutions, -1 when the
+// stream is not valid.
+int bin_decode(const char *data, size_t length, FILE *output);
+
+#endif /* BINFORMAT_H */
@@ -0,0 +1,217 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+#include "utility.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bit-level helpers for the t_grid masks. A line (row or column) of the grid
+// is stored as two uint64_t: the "ones" mask and the "filled" mask. Bit k of
+// a row mask describes column k, bit k of a column mask describes row k.
+
+// Size specialized kernels: the functions marked BB_KERNEL take the size of
+// the grid as a parameter and are always inlined. The entry points (bb_put,
+// the propagation, the choice of a cell) switch on the size of the grid and
+// call the kernel with a literal size in each case, so each of the five legal
+// sizes gets its own instance where the line masks, the bounds of the loops
+// over a line and the index computations are constants.
+#define BB_KERNEL static inline __attribute__((always_inline))
+
+// Runtime CPU dispatch. On x86-64 the entry points marked BB_DISPATCH are
+// compiled twice, once for the baseline instruction set and once with the
+// popcnt instruction, and the loader picks the instance the processor
+// supports: without it every bb_popcount is a call to a library routine. The
+// kernels which handle many lines at once (bb_bad_lines, bb_transpose, the
+// tables of valid lines) have an AVX2 version chosen at each call.
+#if defined(__x86_64__) && defined(__ELF__) && defined(__GNUC__)
+#define BB_X86 1
+#define BB_DISPATCH __attribute__((target_clones("popcnt", "default")))
+#define BB_AVX2 __attribute__((target("avx2")))
+#define bb_has_avx2() __builtin_cpu_supports("avx2")
+#else
+#define BB_X86 0
+#define BB_DISPATCH
+#endif
+
+// Mask with the lowest `size` bits set (every cell of a line)
+static inline uint64_t bb_line_mask(int size) {
+  return size >= 64 ? ~0ULL : (1ULL << size) - 1;
+}
+
+static inline int bb_popcount(uint64_t x) { return __builtin_popcountll(x); }
+
+// Bit k is set when bits k, k + 1 and k + 2 of x are all set
+static inline uint64_t bb_triples(uint64_t x) { return x & (x >> 1) & (x >> 2); }
+
+// Zeros of a line: filled cells which are not ones
+static inline uint64_t bb_zeros(uint64_t ones, uint64_t filled) {
+  return filled & ~ones;
+}
+
+static inline char bb_get(const t_grid *g, int i, int j) {
+  if (!((g->row_filled[i] >> j) & 1)) {
+    return '_';
+  }
+  return ((g->row_ones[i] >> j) & 1) ? '1' : '0';
+}
+
+// A line is sound when it has no three consecutive equal values and no more
+// than size / 2 zeros or ones
+static inline bool bb_line_ok(uint64_t ones, uint64_t filled, int size) {
+  uint64_t zeros = bb_zeros(ones, filled);
+  return bb_triples(ones) == 0 && bb_triples(zeros) == 0 &&
+         bb_popcount(ones) <= size / 2 && bb_popcount(zeros) <= size / 2;
+}
+
+// A set of full lines is an open addressing hash table with linear probing
+// of 2 * size slots: 2 * size keys (ones masks of the lines) followed by
+// 2 * size counts, a count of 0 marking an empty slot. A line pattern shared
+// by several full lines is stored once with its multiplicity, so the number
+// of lines identical to a given one is a single lookup. At most size patterns
+// are stored, the load factor stays under one half.
+
+static inline int bb_set_home(uint64_t key, int slots) {
+  // Fibonacci hashing, slots is a power of two
+  return (int)((key * 0x9E3779B97F4A7C15ULL) >> (64 - __builtin_ctz(slots)));
+}
+
+// Add a full line to the set and return the number of identical lines which
+// were already in it
+BB_KERNEL int bb_line_set_add(uint64_t *set, int size, uint64_t key) {
+  int slots = 2 * size;
+  uint64_t *counts = set + slots;
+  int i = bb_set_home(key, slots);
+
+  while (counts[i] != 0 && set[i] != key) {
+    i = (i + 1) & (slots - 1);
+  }
+  set[i] = key;
+  return (int)counts[i]++;
+}
+
+// Remove a full line from the set and return the number of identical lines
+// which are still in it
+BB_KERNEL int bb_line_set_remove(uint64_t *set, int size, uint64_t key) {
+  int slots = 2 * size;
+  uint64_t *counts = set + slots;
+  int i = bb_set_home(key, slots);
+
+  while (set[i] != key || counts[i] == 0) {
+    i = (i + 1) & (slots - 1);
+  }
+  if (--counts[i] != 0) {
+    return (int)counts[i];
+  }
+
+  // Backward shift deletion: entries placed after the freed slot are moved
+  // back when their home slot allows it, so that no probe chain is broken
+  int j = i;
+  for (;;) {
+    j = (j + 1) & (slots - 1);
+    if (counts[j] == 0) {
+      break;
+    }
+    int home = bb_set_home(set[j], slots);
+    bool movable =
+        (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+    if (movable) {
+      set[i] = set[j];
+      counts[i] = counts[j];
+      counts[j] = 0;
+      i = j;
+    }
+  }
+  return 0;
+}
+
+BB_KERNEL void bb_update_bad_line(uint64_t *bad, int l, uint64_t ones,
+                                  uint64_t filled, int size) {
+  if (bb_line_ok(ones, filled, size)) {
+    *bad &= ~(1ULL << l);
+  } else {
+    *bad |= 1ULL << l;
+  }
+}
+
+// Kernel of bb_put for a grid of the given size
+BB_KERNEL void bb_put_sized(t_grid *g, int i, int j, char v, int size) {
+  char old = bb_get(g, i, j);
+  if (old == v) {
+    return;
+  }
+
+  uint64_t full = bb_line_mask(size);
+  uint64_t rbit = 1ULL << j;
+  uint64_t cbit = 1ULL << i;
+
+  // Pairs of identical full lines involving row i or column j are removed
+  // before the write and counted again afterwards
+  if (g->row_filled[i] == full) {
+    g->dup_lines -= bb_line_set_remove(g->full_rows, size, g->row_ones[i]);
+  }
+  if (g->col_filled[j] == full) {
+    g->dup_lines -= bb_line_set_remove(g->full_cols, size, g->col_ones[j]);
+  }
+
+  if (v == '_') {
+    g->row_filled[i] &= ~rbit;
+    g->col_filled[j] &= ~cbit;
+    g->empty_cells++;
+  } else {
+    g->row_filled[i] |= rbit;
+    g->col_filled[j] |= cbit;
+    if (old == '_') {
+      g->empty_cells--;
+      // Record the cell so that a backtrack can empty it again
+      if (g->trail != NULL) {
+        g->trail[g->trail_len++] = i * size + j;
+      }
+    }
+  }
+  if (v == '1') {
+    g->row_ones[i] |= rbit;
+    g->col_ones[j] |= cbit;
+  } else {
+    g->row_ones[i] &= ~rbit;
+    g->col_ones[j] &= ~cbit;
+  }
+
+  if (g->row_filled[i] == full) {
+    g->dup_lines += bb_line_set_add(g->full_rows, size, g->row_ones[i]);
+  }
+  if (g->col_filled[j] == full) {
+    g->dup_lines += bb_line_set_add(g->full_cols, size, g->col_ones[j]);
+  }
+
+  // A filled cell may allow new inferences on its row and its column. A new
+  // full line removes a candidate from every other line of its direction.
+  if (v != '_') {
+    // Bit i of a row mask is cbit, bit j of a column mask is rbit
+    g->dirty_rows |= (g->row_filled[i] == full) ? full : cbit;
+    g->dirty_cols |= (g->col_filled[j] == full) ? full : rbit;
+  }
+
+  bb_update_bad_line(&g->rows_bad, i, g->row_ones[i], g->row_filled[i], size);
+  bb_update_bad_line(&g->cols_bad, j, g->col_ones[j], g->col_filled[j], size);
+}
+
+// Write a cell in both the row and the column views and update the line
+// state of the grid (bad lines, identical full lines, empty cells, dirty
+// lines). An empty cell which gets a value is pushed on the trail when one is
+// attached. No bound check is performed.
+void bb_put(t_grid *g, int i, int j, char v);
+
+// Mask of the lines (n masks of a grid of the given size) which break a rule:
+// three consecutive equal values or more than size / 2 of a value
+uint64_t bb_bad_lines(const uint64_t *ones, const uint64_t *filled, int n,
+                      int size);
+
+// Transpose a size x size matrix of bits (one mask per row): bit j of in[i]
+// becomes bit i of out[j]. in and out may be the same array.
+void bb_transpose(const uint64_t *in, uint64_t *out, int size);
+
+// Set every cell of an allocated grid at once from the masks of its rows and
+// rebuild the column view and the line state, as size * size calls to bb_put
+// would. The cells are not pushed on the trail, none must be attached.
+void bb_load(t_grid *g, const uint64_t *ones, const uint64_t *filled);
+
+#endif /* BITBOARD_H */
@@ -0,0 +1,11 @@
+#ifndef CDCL_H
+#define CDCL_H
+#include "utility.h"
+#include <stdbool.h>
+
+// Conflict driven clause learning engine for the first solution of a grid.
+// Returns true and fills solution (allocated by the engine) when the grid has
+// a solution, false otherwise.
+bool cdcl_solve(t_grid *grid, t_grid *solution, int verbose);
+
+#endif /* CDCL_H */
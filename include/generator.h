@@ -0,0 +1,26 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+#include "grid.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct {
+  int size;
+  bool unique;   // Grids with a unique solution
+  int count;     // Number of grids to generate
+  int jobs;      // Number of generator threads, one per core when 0
+  uint64_t seed; // Seed of the first grid, grid k is made with seed + k
+  bool verbose;  // Print the time of each grid on stderr
+} t_generator_options;
+
+// Generate many grids with a pool of threads and write them to output in the
+// batch format read by --batch: each grid is preceded by a comment line with
+// its metadata (number, seed, clues, search counters) and followed by a blank
+// line. Grid k is the grid of `-gSIZE [-u] --seed SEED` where SEED is the
+// seed of the options plus k, the output is the same byte for byte whatever
+// the number of threads. The rate of generation is reported on stderr, with
+// the time of each grid in verbose mode.
+void grid_generator_batch(FILE *output, const t_generator_options *options);
+
+#endif /* GENERATOR_H */
@@ -1,6 +1,8 @@
 #ifndef GRID_H
 #define GRID_H
+#include "rng.h"
 #include "utility.h"
+#include "writer.h"
 #include <stdio.h>
 #include <time.h>
 
@@ -10,19 +12,47 @@ typedef struct {
   char choice;
 } choice_t;
 typedef enum { MODE_FIRST, MODE_ALL } t_mode;
+// Search engine of grid_solver: backtracking with propagation (DPLL) or
+// conflict driven clause learning, which only looks for a first solution
+typedef enum { ENGINE_DPLL, ENGINE_CDCL } t_engine;
+// Output of the solutions of MODE_ALL: text, or the compact binary stream of
+// binformat.h
+typedef enum { FORMAT_TEXT, FORMAT_BIN } t_format;
 void grid_copy(t_grid *gs, t_grid *gd);
+void grid_trail_attach(t_grid *g);
+void grid_trail_undo(t_grid *g, int mark);
+void grid_trail_detach(t_grid *g);
 void set_cell(int i, int j, t_grid *g, char v);
 char get_cell(int i, int j, t_grid *g);
 bool is_consistent(t_grid *g, int verbose);
 bool is_valid(t_grid *g);
-void generate_grid(int size, int N, t_grid *g, FILE *fd, int unique_mode,
+// Generate a grid with at least one solution (exactly one in unique_mode),
+// every random draw is taken from rng
+void generate_grid(int size, int N, t_grid *g, int unique_mode, t_rng *rng,
                    int verbose);
-bool check_consecutive_heuristic(t_grid *g);
-bool filled_cell_heuristic(t_grid *g);
-void stabilise_with_heuristics(t_grid *grid);
+bool stabilise_with_heuristics(t_grid *grid);
 void grid_choice_apply(t_grid *grid, const choice_t choice);
 void grid_choice_print(const choice_t choice, FILE *fd);
+choice_t grid_choice_cell(t_grid *grid);
+char grid_choice_value(t_grid *grid, int i, int j);
 choice_t grid_choice(t_grid *grid);
-t_grid *grid_solver(t_grid *grid, const t_mode mode, FILE *output, int verbose);
+// Called for each solution found by grid_enumerate, the grid holds it
+typedef void (*t_solution_handler)(t_grid *grid, void *data);
+void grid_enumerate(t_grid *grid, int verbose, t_solution_handler handler,
+                    void *data);
+// Number of solutions of the grid, counting stops at limit solutions (no
+// limit when limit <= 0). Nothing is printed, the grid is given back unchanged.
+int grid_count_solutions(t_grid *grid, int limit);
+void grid_first_solution_print(t_grid *grid, FILE *output);
+void grid_solution_print(t_grid *grid, int number, FILE *output);
+void grid_solution_write(t_grid *grid, int number, t_writer *writer);
+void grid_solutions_summary(int nb_solutions, FILE *output);
+// Solve the grid in place without printing anything. Returns false, the grid
+// being unchanged, when it has no solution.
+bool grid_solve(t_grid *grid, const t_engine engine);
+// With background_output the solutions of MODE_ALL are written by a thread
+t_grid *grid_solver(t_grid *grid, const t_mode mode, const t_engine engine,
+                    FILE *output, const t_format format,
+                    bool background_output, int verbose);
 
 #endif
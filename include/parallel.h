@@ -0,0 +1,9 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include "grid.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+void grid_solver_parallel(t_grid *grid, FILE *output, int jobs, bool ordered);
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,20 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+#include <stdbool.h>
+#include <stdint.h>
+
+// Table of every valid line of a given size: as many 0s as 1s and no three
+// consecutive equal values. Tables exist for the sizes 4, 8 and 16 (6, 34 and
+// 1296 lines), larger sizes have too many valid lines to be enumerated.
+typedef struct {
+  int size;
+  int count;       // Number of valid lines
+  uint64_t *lines; // Ones mask of each valid line
+} t_line_patterns;
+
+const t_line_patterns *line_patterns(int size);
+bool line_patterns_infer(const t_line_patterns *patterns, uint64_t ones,
+                         uint64_t filled, const uint64_t *full_lines,
+                         uint64_t *forced_ones, uint64_t *forced_zeros);
+
+#endif /* PATTERN_H */
@@ -0,0 +1,34 @@
+#ifndef PORTFOLIO_H
+#define PORTFOLIO_H
+#include "grid.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// How a search of the portfolio picks the cell of its next choice
+typedef enum {
+  CELL_MOST_CONSTRAINED, // See grid_choice_cell
+  CELL_ROW_MAJOR,
+  CELL_COLUMN_MAJOR,
+  CELL_RANDOM
+} t_cell_order;
+// Which value of the chosen cell is tried first
+typedef enum {
+  VALUE_DEMAND, // See grid_choice_value
+  VALUE_ZERO_FIRST,
+  VALUE_ONE_FIRST,
+  VALUE_RANDOM
+} t_value_order;
+
+typedef struct {
+  t_cell_order cell_order;
+  t_value_order value_order;
+  bool propagate; // Apply the heuristics after each choice
+} t_portfolio_config;
+
+// Number of threads used when the number of jobs is not given
+#define PORTFOLIO_DEFAULT_JOBS 4
+
+bool grid_solver_portfolio(t_grid *grid, FILE *output, int jobs);
+
+#endif /* PORTFOLIO_H */
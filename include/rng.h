@@ -0,0 +1,55 @@
+#ifndef RNG_H
+#define RNG_H
+#include <stdbool.h>
+#include <stdint.h>
+
+// Random generator of the grid generators and of the portfolio searches:
+// xoshiro256**, whose whole state is in a t_rng owned by its user, so that
+// each generator (and each thread) draws its own sequence and a seed gives
+// back the exact same grids.
+typedef struct {
+  uint64_t s[4];
+} t_rng;
+
+// The four words of the state are drawn from the seed with splitmix64, any
+// seed (0 included) gives a valid state
+void rng_seed(t_rng *rng, uint64_t seed);
+// Seed which differs from one call to the next, even within a process or a
+// second: the clock in nanoseconds, the process id and a counter are mixed
+uint64_t rng_fresh_seed(void);
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(t_rng *rng) {
+  uint64_t *s = rng->s;
+  uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rng_rotl(s[3], 45);
+  return result;
+}
+
+// Uniform integer in [0, bound) without the bias of a modulo: the high half
+// of a 64 bit product, redrawn in the rare cases which would favour some
+// values (Lemire's method). bound must be positive.
+static inline uint32_t rng_below(t_rng *rng, uint32_t bound) {
+  uint64_t m = (rng_next(rng) >> 32) * bound;
+  if ((uint32_t)m < bound) {
+    uint32_t threshold = -bound % bound;
+    while ((uint32_t)m < threshold) {
+      m = (rng_next(rng) >> 32) * bound;
+    }
+  }
+  return (uint32_t)(m >> 32);
+}
+
+static inline bool rng_bool(t_rng *rng) { return rng_next(rng) >> 63; }
+
+#endif /* RNG_H */
@@ -0,0 +1,50 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+#include "grid.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Depth first search of the solutions of a grid with an explicit stack of
+// choices instead of one recursive call per choice. The stack is allocated
+// once with room for a choice per empty cell, which bounds the depth, and the
+// whole state of the search is in t_search: dfs_next stops at each solution
+// and carries on from there at the next call. The grid is worked on in place
+// through its trail, which must be attached.
+
+typedef struct {
+  choice_t choice; // Value explored at this level
+  int mark;        // Length of the trail before the choice
+  bool second;     // The first value has been explored
+} t_search_frame;
+
+// Cell of the next choice and the value to try first, row is -1 when no
+// value fits the chosen cell (see grid_choice)
+typedef choice_t (*t_chooser)(t_grid *grid, void *data);
+
+typedef struct {
+  t_grid *grid;
+  t_search_frame *stack; // One frame per choice of the current branch
+  int depth;
+  int capacity;
+  bool started;
+  // Settings, dfs_init gives the default of each one
+  t_chooser choose;   // grid_choice when NULL
+  void *data;         // Given to choose
+  bool propagate;     // Apply the heuristics after each choice (true)
+  int budget;         // Choices left before giving up, no limit when < 0
+  atomic_bool *stop;  // The search gives up when raised, unless NULL
+  int verbose;        // Print the choices and the backtracks (0)
+} t_search;
+
+// Stack size of the threads which only run searches, without recursion the
+// default size of the system is much more than they need
+#define SEARCH_THREAD_STACK_SIZE (256 * 1024)
+
+void dfs_init(t_search *s, t_grid *grid);
+// Go on to the next solution. Returns 1 when one is found, the grid holds it;
+// 0 when the tree is exhausted and -1 when the search gives up (budget or
+// stop), the grid being back to its state at dfs_init in both cases.
+int dfs_next(t_search *s);
+void dfs_free(t_search *s);
+
+#endif /* SEARCH_H */
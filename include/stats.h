@@ -0,0 +1,68 @@
+#ifndef STATS_H
+#define STATS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Search statistics (--stats). Each thread counts in its own counters, which
+// a thread adds to the totals of the process with stats_flush when it is done.
+// The counters are plain increments and always run; the work which costs more
+// (reading the clock, telling the rules apart) is only done when stats_enabled
+// is set.
+
+// Rules which fill cells during the propagation
+typedef enum {
+  RULE_PAIR,  // Next to two equal values (00 -> 1001)
+  RULE_GAP,   // Between two equal values (0_0 -> 010)
+  RULE_HALF,  // A line holding size / 2 of a value gets the other one
+  RULE_TABLE, // Tables of valid lines (sizes 4 to 16), all rules at once
+  RULE_CDCL,  // Propagation of the clause learning engine
+  NB_RULES
+} t_rule;
+
+// Phases of the run, the search includes the propagation and, when all the
+// solutions are printed, the output
+typedef enum {
+  PHASE_PARSE,
+  PHASE_SEARCH,
+  PHASE_PROPAGATION,
+  PHASE_GENERATION,
+  PHASE_OUTPUT,
+  NB_PHASES
+} t_phase;
+
+typedef struct {
+  uint64_t nodes;      // Values tried for a cell by a search
+  uint64_t choices;    // Cells chosen to branch on
+  uint64_t backtracks; // Second values tried after the first one failed
+  uint64_t conflicts;  // Dead ends found by the checks or the propagation
+  uint64_t checks;     // Consistency checks
+  uint64_t propagated[NB_RULES]; // Cells filled by each rule
+  uint64_t grid_allocs;          // Grids allocated
+  uint64_t heap_allocs;          // Grids which the pool could not serve
+  int max_depth;                 // Choices on the longest branch
+  double time[NB_PHASES];        // Seconds spent in each phase
+} t_stats;
+
+extern bool stats_enabled;
+extern _Thread_local t_stats thread_stats;
+
+static inline void stats_node(void) { thread_stats.nodes++; }
+static inline void stats_choice(void) { thread_stats.choices++; }
+static inline void stats_backtrack(void) { thread_stats.backtracks++; }
+static inline void stats_conflict(void) { thread_stats.conflicts++; }
+static inline void stats_depth(int depth) {
+  if (depth > thread_stats.max_depth) {
+    thread_stats.max_depth = depth;
+  }
+}
+// Start of a timed phase, 0 when the statistics are disabled
+double stats_clock(void);
+// Add the time since start to the phase
+void stats_time(t_phase phase, double start);
+// Add the counters of the calling thread to the totals and reset them
+void stats_flush(void);
+// Print the totals as text, or as a JSON object
+void stats_print(FILE *output, bool json);
+
+#endif /* STATS_H */
@@ -16,8 +16,28 @@ typedef struct {
   bool output;
   bool generate_mode;
   int generate_size;
+  int jobs;     // Number of worker threads, 0 when not given
+  bool ordered; // Print the solutions in the order of the sequential search
+  bool portfolio; // Race several searches for the first solution
+  bool cdcl;      // Clause learning engine for the first solution
+  bool count;     // Only print the number of solutions
+  int generate_count; // With -g, number of grids to generate, 0 for one
+  int limit;      // Stop counting at this many solutions, 0 for no limit
+  bool batch;     // The input file holds several grids
+  bool output_thread; // Write the solutions from a background thread
+  bool binary;        // Write the solutions in the binary format
+  char *decode_file;  // Binary file of solutions to write as text
+  bool stats;         // Print the search statistics on stderr
+  bool stats_json;    // Print them as JSON
+  bool seeded;        // A seed is given for the generation
+  unsigned long long seed; // Seed of the random generator of the generation
 } globalVariables;
 
+// Options without a short name
+enum { OPT_ORDERED = 256, OPT_PORTFOLIO, OPT_ENGINE, OPT_COUNT,
+       OPT_LIMIT, OPT_BATCH, OPT_OUTPUT_THREAD, OPT_FORMAT, OPT_DECODE,
+       OPT_STATS, OPT_SEED };
+
 static struct option long_options[] = {
     {"help", no_argument, NULL, 'h'},
     {"verbose", no_argument, NULL, 'v'},
@@ -25,6 +45,18 @@ static struct option long_options[] = {
     {"all", no_argument, NULL, 'a'},
     {"generate", optional_argument, NULL, 'g'},
     {"unique", no_argument, NULL, 'u'},
+    {"jobs", required_argument, NULL, 'j'},
+    {"ordered", no_argument, NULL, OPT_ORDERED},
+    {"portfolio", no_argument, NULL, OPT_PORTFOLIO},
+    {"engine", required_argument, NULL, OPT_ENGINE},
+    {"count", optional_argument, NULL, OPT_COUNT},
+    {"limit", required_argument, NULL, OPT_LIMIT},
+    {"batch", no_argument, NULL, OPT_BATCH},
+    {"output-thread", no_argument, NULL, OPT_OUTPUT_THREAD},
+    {"format", required_argument, NULL, OPT_FORMAT},
+    {"decode", required_argument, NULL, OPT_DECODE},
+    {"stats", optional_argument, NULL, OPT_STATS},
+    {"seed", required_argument, NULL, OPT_SEED},
     {NULL, 0, NULL, 0}};
 
 #endif /* TAKUZU_H */
@@ -1,18 +1,81 @@
 #ifndef UTILITY_H
 #define UTILITY_H
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+// The grid is stored as bitboards: one "ones" mask and one "filled" mask per
+// row and per column (see bitboard.h). The full rows and the full columns are
+// also indexed in two hash sets keyed by their ones mask. Masks and sets share
+// one allocation of GRID_WORDS(size) uint64_t, followed by the room of the
+// trail. The state of the lines is kept up to date by every write of a cell,
+// so the consistency of the grid is known without scanning it.
+// Four masks arrays of size words and two sets of 4 * size words
+#define GRID_WORDS(size) (12 * (size))
+
 typedef struct {
-  int size;   // Number of elements in a row
-  char *grid; // Pointer to the grid
+  int size;             // Number of elements in a row
+  uint64_t *row_ones;   // Bit j of row_ones[i] is set when cell (i, j) is '1'
+  uint64_t *row_filled; // Bit j of row_filled[i] is set when (i, j) is not '_'
+  uint64_t *col_ones;   // Bit i of col_ones[j] is set when cell (i, j) is '1'
+  uint64_t *col_filled; // Bit i of col_filled[j] is set when (i, j) is not '_'
+  uint64_t *full_rows;  // Hash set of the full rows (see bitboard.c)
+  uint64_t *full_cols;  // Hash set of the full columns
+  uint64_t rows_bad;    // Bit i is set when row i breaks the count/triple rule
+  uint64_t cols_bad;    // Bit j is set when column j breaks the same rules
+  int dup_lines;        // Number of pairs of identical full rows or columns
+  int empty_cells;      // Number of '_' cells
+  uint64_t dirty_rows;  // Rows to examine again by stabilise_with_heuristics
+  uint64_t dirty_cols;  // Columns to examine again
+  int *trail; // Cells filled since the trail was attached (NULL if detached)
+  int trail_len;        // Number of entries of the trail
 } t_grid;
 
+typedef struct {
+  long heap_allocs; // Grid buffers obtained from the heap
+  long heap_frees;  // Grid buffers given back to the heap
+  long reused;      // Grid allocations served by the pool
+} t_grid_pool_stats;
+
+// Result of the parsing of a grid
+typedef enum {
+  PARSE_OK,
+  PARSE_IO_ERROR,  // The file cannot be opened or read
+  PARSE_EMPTY,     // No row at all
+  PARSE_BAD_CHAR,  // A character other than 0, 1, _, blanks and comments
+  PARSE_BAD_SIZE,  // The first row is not 4, 8, 16, 32 or 64 cells long
+  PARSE_BAD_ROW,   // A row does not have as many cells as the first one
+  PARSE_BAD_LINES, // The grid does not have as many rows as columns
+} t_parse_status;
+
+// Content of an input, mapped in memory for a regular file, read in a buffer
+// for the standard input ("-") and the pipes. The input is never written.
+typedef struct {
+  const char *text;
+  size_t length;
+  bool mapped;
+} t_input;
+
 void PrintHelp();
 void grid_allocate(t_grid *g, int size);
 void grid_free(t_grid *g);
+void grid_pool_release(void);
+t_grid_pool_stats grid_pool_get_stats(void);
+void grid_pool_print_stats(FILE *fd);
+// Text of a grid as printed by grid_print: one line per row, each cell
+// followed by a space. buffer must hold GRID_TEXT_SIZE(size) characters, the
+// length of the text is returned.
+#define GRID_TEXT_SIZE(size) ((size) * (2 * (size) + 1))
+size_t grid_render(const t_grid *g, char *buffer);
 void grid_print(t_grid *g, FILE *fd);
 bool check_char(const char c);
-void file_parser(t_grid *grid, char *filename);
+bool input_open(t_input *input, const char *filename);
+void input_close(t_input *input);
+// Parse the grid of a file ("-" for the standard input), see grid_parse
+t_parse_status file_parser(t_grid *grid, const char *filename,
+                           int *error_line);
+t_parse_status grid_parse(t_grid *grid, const char *text, size_t length,
+                          int *error_line);
+const char *parse_status_message(t_parse_status status);
 
 #endif /* UTILITY_H */
\ No newline at end of file
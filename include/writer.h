@@ -0,0 +1,25 @@
+#ifndef WRITER_H
+#define WRITER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Buffered writer for large outputs (streams of solutions). The text is
+// rendered directly in a large buffer which is written out in one block when
+// it is full. With a background thread the blocks are written by the thread
+// while the caller fills the other buffer, taking the disk writes off the
+// search thread.
+typedef struct t_writer t_writer;
+
+#define WRITER_BUFFER_SIZE (1 << 20)
+
+t_writer *writer_open(FILE *output, bool background);
+// Room for length characters (at most WRITER_BUFFER_SIZE), to be followed by
+// writer_commit with the number of characters actually written
+char *writer_reserve(t_writer *writer, size_t length);
+void writer_commit(t_writer *writer, size_t length);
+void writer_write(t_writer *writer, const char *text, size_t length);
+// Write what is left, stop the thread and free the writer
+void writer_close(t_writer *writer);
+
+#endif /* WRITER_H */
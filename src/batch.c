@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/batch.h"
+#include "../include/pattern.h"
+#include "../include/stats.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Batch solving of a file holding many grids.
+//
+// The reader maps the whole input and cuts it in grids: a grid is a run of
+// lines holding cells, ended by a blank line, a comment line or the end of the
+// input. The solver threads take the grids in input order from a shared
+// counter, each result being rendered in memory by the thread which solved
+// it. The calling thread writes the results in input order, each one as soon
+// as it is ready, so a slow grid only holds back the output, not the solvers.
+
+typedef enum {
+  PUZZLE_SOLVED,
+  PUZZLE_NO_SOLUTION,
+  PUZZLE_COUNTED,
+  PUZZLE_INVALID
+} t_puzzle_status;
+
+typedef struct {
+  const char *text; // Lines of the grid in the input
+  size_t length;
+  int line;       // Line of the input where the grid starts
+  char *result;   // Rendered result, NULL until the grid is solved
+  size_t result_length;
+  t_puzzle_status status;
+} t_puzzle;
+
+typedef struct {
+  const t_batch_options *options;
+  t_puzzle *puzzles;
+  int nb_puzzles;
+  atomic_int next; // Next grid to solve
+  pthread_mutex_t lock;
+  pthread_cond_t done; // Signaled when a result is ready
+} t_batch;
+
+static void *xrealloc(void *p, size_t size) {
+  p = realloc(p, size);
+  if (p == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the batch.\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+// A line holds cells when its first character which is not a blank is not
+// the start of a comment
+static bool is_grid_line(const char *line, const char *end) {
+  while (line < end && (*line == ' ' || *line == '\t' || *line == '\r')) {
+    line++;
+  }
+  return line < end && *line != '#';
+}
+
+// Cut the input in grids
+static t_puzzle *split_puzzles(const char *text, size_t length, int *count) {
+  t_puzzle *puzzles = NULL;
+  int capacity = 0;
+  const char *end = text + length;
+  const char *p = text;
+  int line = 1;
+  bool inside = false;
+
+  *count = 0;
+  while (p < end) {
+    const char *eol = memchr(p, '\n', end - p);
+    if (eol == NULL) {
+      eol = end;
+    }
+    if (is_grid_line(p, eol)) {
+      if (!inside) {
+        if (*count == capacity) {
+          capacity = capacity == 0 ? 64 : 2 * capacity;
+          puzzles =
+              (t_puzzle *)xrealloc(puzzles, capacity * sizeof(t_puzzle));
+        }
+        t_puzzle *puzzle = &puzzles[(*count)++];
+        puzzle->text = p;
+        puzzle->line = line;
+        puzzle->result = NULL;
+        puzzle->result_length = 0;
+        inside = true;
+      }
+      puzzles[*count - 1].length = eol - puzzles[*count - 1].text;
+    } else {
+      inside = false;
+    }
+    if (eol == end) {
+      break;
+    }
+    p = eol + 1;
+    line++;
+  }
+  return puzzles;
+}
+
+static void solve_puzzle(t_batch *batch, int index) {
+  const t_batch_options *options = batch->options;
+  t_puzzle *puzzle = &batch->puzzles[index];
+  char *result = NULL;
+  size_t result_length = 0;
+  FILE *out = open_memstream(&result, &result_length);
+  if (out == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the batch.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  t_grid grid;
+  int error_line;
+  t_puzzle_status status;
+  t_parse_status parse =
+      grid_parse(&grid, puzzle->text, puzzle->length, &error_line);
+
+  fprintf(out, "######################################################\n");
+  fprintf(out, "Grid %d (line %d): ", index + 1, puzzle->line);
+  if (parse != PARSE_OK) {
+    status = PUZZLE_INVALID;
+    fprintf(out, "invalid, line %d: %s\n", puzzle->line + error_line - 1,
+            parse_status_message(parse));
+  } else if (options->count) {
+    status = PUZZLE_COUNTED;
+    int nb_solutions = grid_count_solutions(&grid, options->limit);
+    fprintf(out, "%d solution(s)%s\n", nb_solutions,
+            options->limit > 0 && nb_solutions >= options->limit
+                ? ", limit reached"
+                : "");
+  } else if (grid_solve(&grid, options->engine)) {
+    status = PUZZLE_SOLVED;
+    fprintf(out, "solved\n");
+    grid_print(&grid, out);
+  } else {
+    status = PUZZLE_NO_SOLUTION;
+    fprintf(out, "no solution\n");
+  }
+  if (parse == PARSE_OK) {
+    grid_free(&grid);
+  }
+  fclose(out);
+
+  pthread_mutex_lock(&batch->lock);
+  puzzle->status = status;
+  puzzle->result = result;
+  puzzle->result_length = result_length;
+  pthread_cond_broadcast(&batch->done);
+  pthread_mutex_unlock(&batch->lock);
+}
+
+static void *solver_main(void *arg) {
+  t_batch *batch = (t_batch *)arg;
+  int index;
+
+  while ((index = atomic_fetch_add(&batch->next, 1)) < batch->nb_puzzles) {
+    solve_puzzle(batch, index);
+  }
+  // The grid buffers cached by this thread go back to the heap
+  grid_pool_release();
+  stats_flush();
+  return NULL;
+}
+
+int grid_solver_batch(const char *filename, FILE *output,
+                      const t_batch_options *options) {
+  t_input input;
+  if (!input_open(&input, filename)) {
+    fprintf(stderr, "Error opening file: '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  t_batch batch;
+  batch.options = options;
+  batch.puzzles = split_puzzles(input.text, input.length, &batch.nb_puzzles);
+  atomic_init(&batch.next, 0);
+  pthread_mutex_init(&batch.lock, NULL);
+  pthread_cond_init(&batch.done, NULL);
+
+  // Tables shared by the solvers are built before they start
+  line_patterns(4);
+  line_patterns(8);
+  line_patterns(16);
+
+  // One solver per core when the number of jobs is not given
+  int jobs = options->jobs > 0 ? options->jobs
+                               : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (jobs > batch.nb_puzzles) {
+    jobs = batch.nb_puzzles;
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+  pthread_t *threads = (pthread_t *)xrealloc(NULL, jobs * sizeof(pthread_t));
+  for (int w = 0; w < jobs; w++) {
+    if (pthread_create(&threads[w], NULL, solver_main, &batch) != 0) {
+      fprintf(stderr, "Error: cannot create a solver thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  int counts[PUZZLE_INVALID + 1] = {0};
+  for (int k = 0; k < batch.nb_puzzles; k++) {
+    t_puzzle *puzzle = &batch.puzzles[k];
+    pthread_mutex_lock(&batch.lock);
+    while (puzzle->result == NULL) {
+      pthread_cond_wait(&batch.done, &batch.lock);
+    }
+    pthread_mutex_unlock(&batch.lock);
+    fwrite(puzzle->result, 1, puzzle->result_length, output);
+    free(puzzle->result);
+    counts[puzzle->status]++;
+  }
+  for (int w = 0; w < jobs; w++) {
+    pthread_join(threads[w], NULL);
+  }
+
+  fprintf(output, "######################################################\n");
+  fprintf(output, "Grids: %d, solved: %d, without solution: %d, counted: %d, "
+                  "invalid: %d\n",
+          batch.nb_puzzles, counts[PUZZLE_SOLVED], counts[PUZZLE_NO_SOLUTION],
+          counts[PUZZLE_COUNTED], counts[PUZZLE_INVALID]);
+  fprintf(output, "######################################################\n");
+
+  pthread_mutex_destroy(&batch.lock);
+  pthread_cond_destroy(&batch.done);
+  free(threads);
+  free(batch.puzzles);
+  input_close(&input);
+  grid_pool_release();
+  return counts[PUZZLE_INVALID];
+}
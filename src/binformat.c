@@ -0,0 +1,114 @@
+#include "../include/binformat.h"
+#include "../include/bitboard.h"
+#include "../include/grid.h"
+#include <string.h>
+
+// Bytes of a row (and of the mask of the changed rows)
+static inline int row_bytes(int size) { return (size + 7) / 8; }
+
+void bin_encoder_init(t_bin_encoder *encoder, t_writer *writer, int size) {
+  char header[5];
+
+  encoder->writer = writer;
+  encoder->size = size;
+  memset(encoder->previous, 0, sizeof(encoder->previous));
+  memcpy(header, BIN_MAGIC, 4);
+  header[4] = (char)size;
+  writer_write(writer, header, sizeof(header));
+}
+
+void bin_encode_solution(t_bin_encoder *encoder, const t_grid *grid) {
+  int size = encoder->size;
+  int bytes = row_bytes(size);
+  // The mask and every row in the worst case
+  unsigned char *p = (unsigned char *)writer_reserve(
+      encoder->writer, (size + 1) * bytes);
+  unsigned char *start = p;
+  uint64_t changed = 0;
+
+  for (int i = 0; i < size; i++) {
+    if (grid->row_ones[i] != encoder->previous[i]) {
+      changed |= 1ULL << i;
+    }
+  }
+  for (int b = 0; b < bytes; b++) {
+    *p++ = (unsigned char)(changed >> (8 * b));
+  }
+  while (changed != 0) {
+    int i = __builtin_ctzll(changed);
+    changed &= changed - 1;
+    uint64_t row = grid->row_ones[i];
+    for (int b = 0; b < bytes; b++) {
+      *p++ = (unsigned char)(row >> (8 * b));
+    }
+    encoder->previous[i] = row;
+  }
+  writer_commit(encoder->writer, p - start);
+}
+
+// Little endian value of bytes bytes
+static uint64_t read_bits(const unsigned char *p, int bytes) {
+  uint64_t value = 0;
+  for (int b = 0; b < bytes; b++) {
+    value |= (uint64_t)p[b] << (8 * b);
+  }
+  return value;
+}
+
+int bin_decode(const char *data, size_t length, FILE *output) {
+  const unsigned char *p = (const unsigned char *)data;
+  const unsigned char *end = p + length;
+
+  if (length < 5 || memcmp(p, BIN_MAGIC, 4) != 0) {
+    return -1;
+  }
+  int size = p[4];
+  if (size != 4 && size != 8 && size != 16 && size != 32 && size != 64) {
+    return -1;
+  }
+  p += 5;
+
+  int bytes = row_bytes(size);
+  int nb_solutions = 0;
+  t_grid grid;
+  grid_allocate(&grid, size);
+  // The first delta is taken from an all zero grid
+  for (int i = 0; i < size; i++) {
+    for (int j = 0; j < size; j++) {
+      bb_put(&grid, i, j, '0');
+    }
+  }
+
+  fprintf(output, "Searching for all solutions...\n");
+  fflush(output);
+  t_writer *writer = writer_open(output, false);
+  while (p < end) {
+    if (end - p < bytes) {
+      nb_solutions = -1;
+      break;
+    }
+    uint64_t changed = read_bits(p, bytes);
+    p += bytes;
+    if (end - p < (long)bb_popcount(changed) * bytes ||
+        (changed & ~bb_line_mask(size)) != 0) {
+      nb_solutions = -1;
+      break;
+    }
+    while (changed != 0) {
+      int i = __builtin_ctzll(changed);
+      changed &= changed - 1;
+      uint64_t row = read_bits(p, bytes);
+      p += bytes;
+      for (int j = 0; j < size; j++) {
+        bb_put(&grid, i, j, ((row >> j) & 1) ? '1' : '0');
+      }
+    }
+    grid_solution_write(&grid, ++nb_solutions, writer);
+  }
+  writer_close(writer);
+  grid_free(&grid);
+  if (nb_solutions >= 0) {
+    grid_solutions_summary(nb_solutions, output);
+  }
+  return nb_solutions;
+}
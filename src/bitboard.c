@@ -0,0 +1,181 @@
+#include "../include/bitboard.h"
+#include <string.h>
+#if BB_X86
+#include <immintrin.h>
+#endif
+
+BB_DISPATCH void bb_put(t_grid *g, int i, int j, char v) {
+  switch (g->size) {
+  case 4:
+    bb_put_sized(g, i, j, v, 4);
+    break;
+  case 8:
+    bb_put_sized(g, i, j, v, 8);
+    break;
+  case 16:
+    bb_put_sized(g, i, j, v, 16);
+    break;
+  case 32:
+    bb_put_sized(g, i, j, v, 32);
+    break;
+  case 64:
+    bb_put_sized(g, i, j, v, 64);
+    break;
+  default:
+    bb_put_sized(g, i, j, v, g->size);
+  }
+}
+
+// Masks of the columns whose index has the bit j clear, indexed by log2(j)
+static const uint64_t transpose_masks[6] = {
+    0x5555555555555555ULL, 0x3333333333333333ULL, 0x0F0F0F0F0F0F0F0FULL,
+    0x00FF00FF00FF00FFULL, 0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL};
+
+// One step of the transpose: the columns with the bit j set of the rows with
+// the bit j clear are swapped with the columns with the bit j clear of the
+// rows with the bit j set
+static void transpose_step(uint64_t *a, int size, int j) {
+  uint64_t m = transpose_masks[__builtin_ctz(j)];
+  for (int k = 0; k < size; k = ((k | j) + 1) & ~j) {
+    uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+    a[k | j] ^= t;
+    a[k] ^= t << j;
+  }
+}
+
+#if BB_X86
+// Bit counts of the four lanes
+BB_AVX2 static inline __m256i popcount_avx2(__m256i v) {
+  const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2,
+                                         3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                         2, 3, 2, 3, 3, 4);
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+  __m256i high = _mm256_shuffle_epi8(
+      table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+  return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+// Bit k of each lane is set when bits k, k + 1 and k + 2 are all set
+BB_AVX2 static inline __m256i triples_avx2(__m256i x) {
+  return _mm256_and_si256(
+      x, _mm256_and_si256(_mm256_srli_epi64(x, 1), _mm256_srli_epi64(x, 2)));
+}
+
+// Four lines at a time, n is a multiple of 4
+BB_AVX2 static uint64_t bad_lines_avx2(const uint64_t *ones,
+                                       const uint64_t *filled, int n,
+                                       int size) {
+  const __m256i half = _mm256_set1_epi64x(size / 2);
+  const __m256i zero = _mm256_setzero_si256();
+  uint64_t bad = 0;
+
+  for (int l = 0; l < n; l += 4) {
+    __m256i o = _mm256_loadu_si256((const __m256i *)(ones + l));
+    __m256i f = _mm256_loadu_si256((const __m256i *)(filled + l));
+    __m256i z = _mm256_andnot_si256(o, f);
+    __m256i triples = _mm256_or_si256(triples_avx2(o), triples_avx2(z));
+    __m256i over = _mm256_or_si256(_mm256_cmpgt_epi64(popcount_avx2(o), half),
+                                   _mm256_cmpgt_epi64(popcount_avx2(z), half));
+    int sound = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(triples, zero)));
+    int broken = _mm256_movemask_pd(_mm256_castsi256_pd(over));
+    bad |= (uint64_t)((~sound | broken) & 0xF) << l;
+  }
+  return bad;
+}
+
+// The steps which swap blocks of at least four rows work on four rows at a
+// time, the last two are done a row at a time
+BB_AVX2 static void transpose_avx2(uint64_t *a, int size) {
+  int j = size / 2;
+  for (; j >= 4; j /= 2) {
+    __m256i m = _mm256_set1_epi64x(transpose_masks[__builtin_ctz(j)]);
+    __m128i shift = _mm_cvtsi32_si128(j);
+    for (int k = 0; k < size; k = ((k | j) + 4) & ~j) {
+      __m256i low = _mm256_loadu_si256((const __m256i *)(a + k));
+      __m256i high = _mm256_loadu_si256((const __m256i *)(a + (k | j)));
+      __m256i t = _mm256_and_si256(
+          _mm256_xor_si256(_mm256_srl_epi64(low, shift), high), m);
+      _mm256_storeu_si256((__m256i *)(a + (k | j)),
+                          _mm256_xor_si256(high, t));
+      _mm256_storeu_si256((__m256i *)(a + k),
+                          _mm256_xor_si256(low, _mm256_sll_epi64(t, shift)));
+    }
+  }
+  for (; j >= 1; j /= 2) {
+    transpose_step(a, size, j);
+  }
+}
+#endif
+
+uint64_t bb_bad_lines(const uint64_t *ones, const uint64_t *filled, int n,
+                      int size) {
+  uint64_t bad = 0;
+  int l = 0;
+#if BB_X86
+  if (bb_has_avx2()) {
+    l = n & ~3;
+    bad = bad_lines_avx2(ones, filled, l, size);
+  }
+#endif
+  for (; l < n; l++) {
+    if (!bb_line_ok(ones[l], filled[l], size)) {
+      bad |= 1ULL << l;
+    }
+  }
+  return bad;
+}
+
+// Transpose in place by swapping blocks of half the size, then of a quarter
+// and so on down to single bits (log2(size) steps)
+void bb_transpose(const uint64_t *in, uint64_t *out, int size) {
+  if (out != in) {
+    memcpy(out, in, size * sizeof(uint64_t));
+  }
+#if BB_X86
+  if (bb_has_avx2()) {
+    transpose_avx2(out, size);
+    return;
+  }
+#endif
+  for (int j = size / 2; j >= 1; j /= 2) {
+    transpose_step(out, size, j);
+  }
+}
+
+BB_DISPATCH void bb_load(t_grid *g, const uint64_t *ones,
+                         const uint64_t *filled) {
+  int size = g->size;
+  uint64_t full = bb_line_mask(size);
+
+  memcpy(g->row_ones, ones, size * sizeof(uint64_t));
+  memcpy(g->row_filled, filled, size * sizeof(uint64_t));
+  bb_transpose(g->row_ones, g->col_ones, size);
+  bb_transpose(g->row_filled, g->col_filled, size);
+  g->rows_bad = bb_bad_lines(g->row_ones, g->row_filled, size, size);
+  g->cols_bad = bb_bad_lines(g->col_ones, g->col_filled, size, size);
+
+  // Both sets of full lines follow the column masks
+  memset(g->full_rows, 0, 8 * size * sizeof(uint64_t));
+  g->dup_lines = 0;
+  g->empty_cells = size * size;
+  g->dirty_rows = 0;
+  g->dirty_cols = 0;
+  for (int l = 0; l < size; l++) {
+    g->empty_cells -= bb_popcount(g->row_filled[l]);
+    // As in bb_put, a full line makes every line of its direction dirty
+    if (g->row_filled[l] == full) {
+      g->dup_lines += bb_line_set_add(g->full_rows, size, g->row_ones[l]);
+      g->dirty_rows |= full;
+    } else if (g->row_filled[l] != 0) {
+      g->dirty_rows |= 1ULL << l;
+    }
+    if (g->col_filled[l] == full) {
+      g->dup_lines += bb_line_set_add(g->full_cols, size, g->col_ones[l]);
+      g->dirty_cols |= full;
+    } else if (g->col_filled[l] != 0) {
+      g->dirty_cols |= 1ULL << l;
+    }
+  }
+}
@@ -0,0 +1,742 @@
+#include "../include/cdcl.h"
+#include "../include/bitboard.h"
+#include "../include/stats.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Conflict driven clause learning (CDCL) engine.
+//
+// The cell v = i * size + j is a boolean variable. The literal 2 * v + b is
+// true when the cell holds the value b, its negation is lit ^ 1. The rules of
+// the game are enforced by:
+// - static clauses for the triple rule: any three consecutive cells of a line
+//   hold at least one 0 and at least one 1;
+// - a count propagator: once a line holds size / 2 of a value, its other cells
+//   get the other value;
+// - a duplicate propagator: a line differing from a full line of the same
+//   direction in one empty cell only gets the other value in that cell, and
+//   two identical full lines are a conflict.
+// The propagators explain their implications lazily: the reason of a cell is
+// rebuilt from the cells assigned before it when the conflict analysis needs
+// it. Each conflict is analysed up to the first unique implication point, the
+// learnt clause is added to the clause database and the search jumps back to
+// the second highest level of the clause. Branching uses VSIDS activities with
+// phase saving, and the search restarts following the Luby sequence.
+
+#define LIT(v, b) (2 * (v) + (b))
+#define LIT_VAR(l) ((l) >> 1)
+#define LIT_VAL(l) ((l) & 1)
+
+// Offsets of the fields of a clause in the arena, the literals follow
+#define CLAUSE_SIZE 0
+#define CLAUSE_FLAGS 1
+#define CLAUSE_LITS 2
+#define CLAUSE_LEARNT 1
+#define CLAUSE_DELETED 2
+
+#define RESTART_BASE 100
+
+enum { REASON_DECISION, REASON_CLAUSE, REASON_COUNT, REASON_DUP };
+
+typedef struct {
+  int *data;
+  int len;
+  int capacity;
+} t_vec;
+
+typedef struct {
+  int size;
+  int nb_vars;
+  signed char *value; // 0, 1 or -1 when the cell is not assigned yet
+  signed char *phase; // Last value of each cell, tried first on a decision
+  int *level;         // Decision level of each assigned cell
+  int *trail_pos;     // Position of each assigned cell in the trail
+  int *reason_kind;
+  int *reason_data; // Clause, (line, value) or full line of the reason
+  double *activity;
+  double var_inc;
+  int *heap;       // Binary max-heap of the cells ordered by activity
+  int *heap_index; // Position of each cell in the heap, -1 when it is out
+  int heap_len;
+  char *seen;
+  int *trail; // Assigned literals in assignment order
+  int trail_len;
+  int qhead; // Next literal of the trail to propagate
+  int *trail_lim; // Trail length at the start of each decision level
+  int nb_levels;
+  // Masks of the lines: 0 .. size - 1 are the rows, size .. 2 * size - 1
+  // the columns
+  uint64_t *ones;
+  uint64_t *filled;
+  t_vec arena;    // Clauses: size, flags, literals
+  t_vec clauses;  // Static clauses
+  t_vec learnts;  // Learnt clauses
+  t_vec *watches; // Clauses watching each literal
+  t_vec conflict; // False literals of the last conflict
+  t_vec reason;
+  t_vec learnt;
+  int max_learnts;
+  long decisions;
+  long conflicts;
+  long propagations;
+} t_cdcl;
+
+static void *cdcl_alloc(size_t count, size_t size) {
+  void *p = calloc(count, size);
+  if (p == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the CDCL engine.\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+static void vec_push(t_vec *vec, int x) {
+  if (vec->len == vec->capacity) {
+    vec->capacity = vec->capacity == 0 ? 8 : 2 * vec->capacity;
+    vec->data = (int *)realloc(vec->data, vec->capacity * sizeof(int));
+    if (vec->data == NULL) {
+      fprintf(stderr,
+              "Error: Memory allocation failed for the CDCL engine.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  vec->data[vec->len++] = x;
+}
+
+static void heap_up(t_cdcl *s, int pos) {
+  int v = s->heap[pos];
+  while (pos > 0) {
+    int parent = (pos - 1) / 2;
+    if (s->activity[s->heap[parent]] >= s->activity[v]) {
+      break;
+    }
+    s->heap[pos] = s->heap[parent];
+    s->heap_index[s->heap[pos]] = pos;
+    pos = parent;
+  }
+  s->heap[pos] = v;
+  s->heap_index[v] = pos;
+}
+
+static void heap_down(t_cdcl *s, int pos) {
+  int v = s->heap[pos];
+  for (;;) {
+    int child = 2 * pos + 1;
+    if (child >= s->heap_len) {
+      break;
+    }
+    if (child + 1 < s->heap_len &&
+        s->activity[s->heap[child + 1]] > s->activity[s->heap[child]]) {
+      child++;
+    }
+    if (s->activity[s->heap[child]] <= s->activity[v]) {
+      break;
+    }
+    s->heap[pos] = s->heap[child];
+    s->heap_index[s->heap[pos]] = pos;
+    pos = child;
+  }
+  s->heap[pos] = v;
+  s->heap_index[v] = pos;
+}
+
+static void heap_insert(t_cdcl *s, int v) {
+  if (s->heap_index[v] < 0) {
+    s->heap[s->heap_len] = v;
+    s->heap_index[v] = s->heap_len;
+    heap_up(s, s->heap_len++);
+  }
+}
+
+static int heap_pop(t_cdcl *s) {
+  int v = s->heap[0];
+  s->heap_index[v] = -1;
+  if (--s->heap_len > 0) {
+    s->heap[0] = s->heap[s->heap_len];
+    heap_down(s, 0);
+  }
+  return v;
+}
+
+// Cell at the position k of a line
+static inline int line_cell(const t_cdcl *s, int line, int k) {
+  return line < s->size ? line * s->size + k
+                        : k * s->size + (line - s->size);
+}
+
+static inline int lit_value(const t_cdcl *s, int lit) {
+  int value = s->value[LIT_VAR(lit)];
+  return value < 0 ? -1 : value == LIT_VAL(lit);
+}
+
+static void assign(t_cdcl *s, int lit, int kind, int data) {
+  int v = LIT_VAR(lit);
+  int i = v / s->size;
+  int j = v % s->size;
+
+  s->value[v] = (signed char)LIT_VAL(lit);
+  s->level[v] = s->nb_levels;
+  s->trail_pos[v] = s->trail_len;
+  s->reason_kind[v] = kind;
+  s->reason_data[v] = data;
+  s->trail[s->trail_len++] = lit;
+  s->filled[i] |= 1ULL << j;
+  s->filled[s->size + j] |= 1ULL << i;
+  if (LIT_VAL(lit)) {
+    s->ones[i] |= 1ULL << j;
+    s->ones[s->size + j] |= 1ULL << i;
+  }
+}
+
+static void backtrack(t_cdcl *s, int level) {
+  if (s->nb_levels <= level) {
+    return;
+  }
+  int limit = s->trail_lim[level];
+  while (s->trail_len > limit) {
+    int lit = s->trail[--s->trail_len];
+    int v = LIT_VAR(lit);
+    int i = v / s->size;
+    int j = v % s->size;
+    s->phase[v] = s->value[v];
+    s->value[v] = -1;
+    heap_insert(s, v);
+    s->filled[i] &= ~(1ULL << j);
+    s->filled[s->size + j] &= ~(1ULL << i);
+    s->ones[i] &= ~(1ULL << j);
+    s->ones[s->size + j] &= ~(1ULL << i);
+  }
+  s->qhead = s->trail_len;
+  s->nb_levels = level;
+}
+
+// Push the negation of the premises of the implication of the cell v, that is
+// to say the false literals of its reason clause. Only the cells assigned
+// before the position limit of the trail are premises.
+static void explain(t_cdcl *s, int v, int kind, int data, int limit,
+                    t_vec *out) {
+  int n = s->size;
+
+  switch (kind) {
+  case REASON_CLAUSE: {
+    int *lits = s->arena.data + data + CLAUSE_LITS;
+    for (int k = 0; k < s->arena.data[data + CLAUSE_SIZE]; k++) {
+      if (LIT_VAR(lits[k]) != v) {
+        vec_push(out, lits[k]);
+      }
+    }
+    break;
+  }
+  case REASON_COUNT: {
+    // size / 2 cells of the line hold the value b
+    int line = data >> 1;
+    int b = data & 1;
+    int found = 0;
+    for (int k = 0; k < n && found < n / 2; k++) {
+      int c = line_cell(s, line, k);
+      if (s->value[c] == b && s->trail_pos[c] < limit) {
+        vec_push(out, LIT(c, b) ^ 1);
+        found++;
+      }
+    }
+    break;
+  }
+  case REASON_DUP: {
+    // The full line data and the line of v agree on every other cell
+    int full_line = data;
+    int line = full_line < n ? v / n : n + v % n;
+    int pos = full_line < n ? v % n : v / n;
+    for (int k = 0; k < n; k++) {
+      int c = line_cell(s, full_line, k);
+      vec_push(out, LIT(c, s->value[c]) ^ 1);
+      if (k != pos) {
+        c = line_cell(s, line, k);
+        vec_push(out, LIT(c, s->value[c]) ^ 1);
+      }
+    }
+    break;
+  }
+  }
+}
+
+// Set a literal implied by a propagator. Returns false, with the conflict
+// clause, when the literal is already false.
+static bool imply(t_cdcl *s, int lit, int kind, int data) {
+  int value = lit_value(s, lit);
+  if (value == 1) {
+    return true;
+  }
+  if (value == 0) {
+    s->conflict.len = 0;
+    explain(s, LIT_VAR(lit), kind, data, s->trail_len, &s->conflict);
+    vec_push(&s->conflict, lit);
+    return false;
+  }
+  assign(s, lit, kind, data);
+  return true;
+}
+
+// Count and duplicate rules on the row and the column of the literal p
+BB_DISPATCH static bool propagate_lines(t_cdcl *s, int p) {
+  int n = s->size;
+  int v = LIT_VAR(p);
+  int b = LIT_VAL(p);
+  uint64_t full = bb_line_mask(n);
+  int lines[2] = {v / n, n + v % n};
+
+  for (int t = 0; t < 2; t++) {
+    int line = lines[t];
+    uint64_t values =
+        b ? s->ones[line] : bb_zeros(s->ones[line], s->filled[line]);
+    int count = bb_popcount(values);
+
+    if (count > n / 2) {
+      // p is kept in the clause so that it has a literal of the current level
+      s->conflict.len = 0;
+      vec_push(&s->conflict, p ^ 1);
+      for (int k = 0; k < n && s->conflict.len <= n / 2; k++) {
+        int c = line_cell(s, line, k);
+        if (((values >> k) & 1) && c != v) {
+          vec_push(&s->conflict, LIT(c, b) ^ 1);
+        }
+      }
+      return false;
+    }
+    if (count == n / 2) {
+      uint64_t empty = full & ~s->filled[line];
+      while (empty != 0) {
+        int k = __builtin_ctzll(empty);
+        empty &= empty - 1;
+        if (!imply(s, LIT(line_cell(s, line, k), !b), REASON_COUNT,
+                   2 * line + b)) {
+          return false;
+        }
+      }
+    }
+
+    // Duplicate rule, only useful when the line has at most one empty cell
+    int first = line < n ? 0 : n;
+    if (bb_popcount(full & ~s->filled[line]) > 1) {
+      continue;
+    }
+    for (int other = first; other < first + n; other++) {
+      if (other == line) {
+        continue;
+      }
+      int full_line, open_line;
+      if (s->filled[line] == full && s->filled[other] == full) {
+        if (s->ones[line] == s->ones[other]) {
+          s->conflict.len = 0;
+          for (int k = 0; k < n; k++) {
+            int c = line_cell(s, line, k);
+            vec_push(&s->conflict, LIT(c, s->value[c]) ^ 1);
+            c = line_cell(s, other, k);
+            vec_push(&s->conflict, LIT(c, s->value[c]) ^ 1);
+          }
+          return false;
+        }
+        continue;
+      } else if (s->filled[line] == full) {
+        full_line = line;
+        open_line = other;
+      } else if (s->filled[other] == full) {
+        full_line = other;
+        open_line = line;
+      } else {
+        continue;
+      }
+      uint64_t empty = full & ~s->filled[open_line];
+      if (bb_popcount(empty) != 1 ||
+          ((s->ones[open_line] ^ s->ones[full_line]) & s->filled[open_line]) !=
+              0) {
+        continue;
+      }
+      int k = __builtin_ctzll(empty);
+      int value = (int)((s->ones[full_line] >> k) & 1);
+      if (!imply(s, LIT(line_cell(s, open_line, k), !value), REASON_DUP,
+                 full_line)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Unit propagation of the clauses (two watched literals) and of the line
+// rules. Returns false on a conflict, s->conflict then holds its clause.
+static bool propagate(t_cdcl *s) {
+  while (s->qhead < s->trail_len) {
+    int p = s->trail[s->qhead++];
+    int false_lit = p ^ 1;
+    t_vec *ws = &s->watches[false_lit];
+    int i = 0;
+    int j = 0;
+
+    s->propagations++;
+    while (i < ws->len) {
+      int c = ws->data[i++];
+      int *header = s->arena.data + c;
+      int *lits = header + CLAUSE_LITS;
+      if (header[CLAUSE_FLAGS] & CLAUSE_DELETED) {
+        continue;
+      }
+      // The false literal is kept in lits[1]
+      if (lits[0] == false_lit) {
+        lits[0] = lits[1];
+        lits[1] = false_lit;
+      }
+      if (lit_value(s, lits[0]) == 1) {
+        ws->data[j++] = c;
+        continue;
+      }
+      bool moved = false;
+      for (int k = 2; k < header[CLAUSE_SIZE]; k++) {
+        if (lit_value(s, lits[k]) != 0) {
+          lits[1] = lits[k];
+          lits[k] = false_lit;
+          vec_push(&s->watches[lits[1]], c);
+          moved = true;
+          break;
+        }
+      }
+      if (moved) {
+        continue;
+      }
+      ws->data[j++] = c;
+      if (lit_value(s, lits[0]) == 0) {
+        s->conflict.len = 0;
+        for (int k = 0; k < header[CLAUSE_SIZE]; k++) {
+          vec_push(&s->conflict, lits[k]);
+        }
+        while (i < ws->len) {
+          ws->data[j++] = ws->data[i++];
+        }
+        ws->len = j;
+        return false;
+      }
+      assign(s, lits[0], REASON_CLAUSE, c);
+    }
+    ws->len = j;
+
+    if (!propagate_lines(s, p)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int add_clause(t_cdcl *s, const int *lits, int len, bool learnt) {
+  int c = s->arena.len;
+  vec_push(&s->arena, len);
+  vec_push(&s->arena, learnt ? CLAUSE_LEARNT : 0);
+  for (int k = 0; k < len; k++) {
+    vec_push(&s->arena, lits[k]);
+  }
+  vec_push(&s->watches[lits[0]], c);
+  vec_push(&s->watches[lits[1]], c);
+  vec_push(learnt ? &s->learnts : &s->clauses, c);
+  return c;
+}
+
+static void bump_activity(t_cdcl *s, int v) {
+  s->activity[v] += s->var_inc;
+  if (s->activity[v] > 1e100) {
+    // Scaling every activity keeps the heap order
+    for (int k = 0; k < s->nb_vars; k++) {
+      s->activity[k] *= 1e-100;
+    }
+    s->var_inc *= 1e-100;
+  }
+  if (s->heap_index[v] >= 0) {
+    heap_up(s, s->heap_index[v]);
+  }
+}
+
+// First unique implication point analysis of the conflict. The learnt
+// clause is left in s->learnt with its asserting literal first and the
+// literal of the highest remaining level second. Returns the level to jump
+// back to.
+static int analyze(t_cdcl *s) {
+  int path = 0;
+  int p = -1;
+  int index = s->trail_len - 1;
+  t_vec *reason = &s->conflict;
+
+  s->learnt.len = 0;
+  vec_push(&s->learnt, 0); // room of the asserting literal
+  do {
+    for (int k = 0; k < reason->len; k++) {
+      int v = LIT_VAR(reason->data[k]);
+      if (!s->seen[v] && s->level[v] > 0) {
+        s->seen[v] = 1;
+        bump_activity(s, v);
+        if (s->level[v] >= s->nb_levels) {
+          path++;
+        } else {
+          vec_push(&s->learnt, reason->data[k]);
+        }
+      }
+    }
+    // Next cell of the current level to resolve, in reverse trail order
+    while (!s->seen[LIT_VAR(s->trail[index])]) {
+      index--;
+    }
+    p = s->trail[index--];
+    int v = LIT_VAR(p);
+    s->seen[v] = 0;
+    path--;
+    if (path > 0) {
+      s->reason.len = 0;
+      explain(s, v, s->reason_kind[v], s->reason_data[v], s->trail_pos[v],
+              &s->reason);
+      reason = &s->reason;
+    }
+  } while (path > 0);
+  s->learnt.data[0] = p ^ 1;
+
+  int back_level = 0;
+  for (int k = 1; k < s->learnt.len; k++) {
+    int v = LIT_VAR(s->learnt.data[k]);
+    s->seen[v] = 0;
+    if (s->level[v] > back_level) {
+      back_level = s->level[v];
+      int tmp = s->learnt.data[1];
+      s->learnt.data[1] = s->learnt.data[k];
+      s->learnt.data[k] = tmp;
+    }
+  }
+  return back_level;
+}
+
+// Unassigned cell with the highest activity, -1 when every cell is set.
+// Assigned cells are dropped from the heap lazily.
+static int pick_branch_var(t_cdcl *s) {
+  while (s->heap_len > 0) {
+    int v = heap_pop(s);
+    if (s->value[v] < 0) {
+      return v;
+    }
+  }
+  return -1;
+}
+
+// Luby sequence: 1 1 2 1 1 2 4 1 1 2 ...
+static int luby(int x) {
+  int size = 1;
+  int seq = 0;
+  while (size < x + 1) {
+    seq++;
+    size = 2 * size + 1;
+  }
+  while (size - 1 != x) {
+    size = (size - 1) >> 1;
+    seq--;
+    x = x % size;
+  }
+  return 1 << seq;
+}
+
+static bool clause_locked(t_cdcl *s, int c) {
+  int v = LIT_VAR(s->arena.data[c + CLAUSE_LITS]);
+  return s->value[v] >= 0 && s->reason_kind[v] == REASON_CLAUSE &&
+         s->reason_data[v] == c;
+}
+
+// Delete half of the longest learnt clauses which are not a reason, then
+// rebuild the watch lists. Called at level 0 after a restart.
+static void reduce_learnts(t_cdcl *s) {
+  int kept = 0;
+  int target = s->learnts.len / 2;
+  int removed = 0;
+
+  for (int max_len = 2 * s->size + 1; max_len > 3 && removed < target;
+       max_len--) {
+    for (int k = 0; k < s->learnts.len && removed < target; k++) {
+      int c = s->learnts.data[k];
+      int *header = s->arena.data + c;
+      if (!(header[CLAUSE_FLAGS] & CLAUSE_DELETED) &&
+          header[CLAUSE_SIZE] >= max_len && !clause_locked(s, c)) {
+        header[CLAUSE_FLAGS] |= CLAUSE_DELETED;
+        removed++;
+      }
+    }
+  }
+  for (int k = 0; k < s->learnts.len; k++) {
+    int c = s->learnts.data[k];
+    if (!(s->arena.data[c + CLAUSE_FLAGS] & CLAUSE_DELETED)) {
+      s->learnts.data[kept++] = c;
+    }
+  }
+  s->learnts.len = kept;
+
+  for (int l = 0; l < 2 * s->nb_vars; l++) {
+    s->watches[l].len = 0;
+  }
+  t_vec *lists[2] = {&s->clauses, &s->learnts};
+  for (int t = 0; t < 2; t++) {
+    for (int k = 0; k < lists[t]->len; k++) {
+      int c = lists[t]->data[k];
+      vec_push(&s->watches[s->arena.data[c + CLAUSE_LITS]], c);
+      vec_push(&s->watches[s->arena.data[c + CLAUSE_LITS + 1]], c);
+    }
+  }
+}
+
+static void cdcl_init(t_cdcl *s, int size) {
+  memset(s, 0, sizeof(t_cdcl));
+  s->size = size;
+  s->nb_vars = size * size;
+  s->value = (signed char *)cdcl_alloc(s->nb_vars, sizeof(signed char));
+  s->phase = (signed char *)cdcl_alloc(s->nb_vars, sizeof(signed char));
+  s->level = (int *)cdcl_alloc(s->nb_vars, sizeof(int));
+  s->trail_pos = (int *)cdcl_alloc(s->nb_vars, sizeof(int));
+  s->reason_kind = (int *)cdcl_alloc(s->nb_vars, sizeof(int));
+  s->reason_data = (int *)cdcl_alloc(s->nb_vars, sizeof(int));
+  s->activity = (double *)cdcl_alloc(s->nb_vars, sizeof(double));
+  s->heap = (int *)cdcl_alloc(s->nb_vars, sizeof(int));
+  s->heap_index = (int *)cdcl_alloc(s->nb_vars, sizeof(int));
+  s->seen = (char *)cdcl_alloc(s->nb_vars, sizeof(char));
+  s->trail = (int *)cdcl_alloc(s->nb_vars, sizeof(int));
+  s->trail_lim = (int *)cdcl_alloc(s->nb_vars + 1, sizeof(int));
+  s->ones = (uint64_t *)cdcl_alloc(2 * size, sizeof(uint64_t));
+  s->filled = (uint64_t *)cdcl_alloc(2 * size, sizeof(uint64_t));
+  s->watches = (t_vec *)cdcl_alloc(2 * s->nb_vars, sizeof(t_vec));
+  memset(s->value, -1, s->nb_vars);
+  for (int v = 0; v < s->nb_vars; v++) {
+    s->heap_index[v] = -1;
+    heap_insert(s, v);
+  }
+  s->var_inc = 1.0;
+  s->max_learnts = 4 * s->nb_vars;
+
+  // Triple rule: three consecutive cells hold at least one 1 and one 0
+  for (int line = 0; line < 2 * size; line++) {
+    for (int k = 0; k + 2 < size; k++) {
+      for (int b = 0; b <= 1; b++) {
+        int lits[3];
+        for (int t = 0; t < 3; t++) {
+          lits[t] = LIT(line_cell(s, line, k + t), b);
+        }
+        add_clause(s, lits, 3, false);
+      }
+    }
+  }
+}
+
+static void cdcl_free(t_cdcl *s) {
+  free(s->value);
+  free(s->phase);
+  free(s->level);
+  free(s->trail_pos);
+  free(s->reason_kind);
+  free(s->reason_data);
+  free(s->activity);
+  free(s->heap);
+  free(s->heap_index);
+  free(s->seen);
+  free(s->trail);
+  free(s->trail_lim);
+  free(s->ones);
+  free(s->filled);
+  for (int l = 0; l < 2 * s->nb_vars; l++) {
+    free(s->watches[l].data);
+  }
+  free(s->watches);
+  free(s->arena.data);
+  free(s->clauses.data);
+  free(s->learnts.data);
+  free(s->conflict.data);
+  free(s->reason.data);
+  free(s->learnt.data);
+}
+
+static bool cdcl_search(t_cdcl *s) {
+  int restarts = 0;
+  long restart_limit = RESTART_BASE * luby(restarts);
+  long conflicts_since_restart = 0;
+
+  for (;;) {
+    if (!propagate(s)) {
+      s->conflicts++;
+      conflicts_since_restart++;
+      if (s->nb_levels == 0) {
+        return false;
+      }
+      int back_level = analyze(s);
+      backtrack(s, back_level);
+      if (s->learnt.len == 1) {
+        assign(s, s->learnt.data[0], REASON_DECISION, 0);
+      } else {
+        int c = add_clause(s, s->learnt.data, s->learnt.len, true);
+        assign(s, s->learnt.data[0], REASON_CLAUSE, c);
+      }
+      s->var_inc /= 0.95;
+      continue;
+    }
+
+    if (conflicts_since_restart >= restart_limit) {
+      backtrack(s, 0);
+      conflicts_since_restart = 0;
+      restart_limit = RESTART_BASE * luby(++restarts);
+      if (s->learnts.len > s->max_learnts) {
+        reduce_learnts(s);
+        s->max_learnts += s->max_learnts / 10;
+      }
+      continue;
+    }
+
+    int v = pick_branch_var(s);
+    if (v < 0) {
+      return true;
+    }
+    s->decisions++;
+    stats_node();
+    stats_choice();
+    s->trail_lim[s->nb_levels++] = s->trail_len;
+    stats_depth(s->nb_levels);
+    assign(s, LIT(v, s->phase[v]), REASON_DECISION, 0);
+  }
+}
+
+bool cdcl_solve(t_grid *grid, t_grid *solution, int verbose) {
+  t_cdcl s;
+  int n = grid->size;
+  bool sat = true;
+
+  cdcl_init(&s, n);
+  // The clues are set at level 0
+  for (int i = 0; i < n && sat; i++) {
+    for (int j = 0; j < n; j++) {
+      char c = bb_get(grid, i, j);
+      if (c != '_') {
+        int lit = LIT(i * n + j, c == '1');
+        assign(&s, lit, REASON_DECISION, 0);
+      }
+    }
+  }
+  sat = cdcl_search(&s);
+
+  if (sat) {
+    uint64_t ones[64] = {0};
+    uint64_t filled[64];
+    for (int v = 0; v < s.nb_vars; v++) {
+      ones[v / n] |= (uint64_t)(s.value[v] == 1) << (v % n);
+    }
+    for (int i = 0; i < n; i++) {
+      filled[i] = bb_line_mask(n);
+    }
+    grid_allocate(solution, n);
+    bb_load(solution, ones, filled);
+  }
+  thread_stats.conflicts += s.conflicts;
+  thread_stats.propagated[RULE_CDCL] += s.propagations;
+  if (verbose) {
+    printf("CDCL: %ld decisions, %ld conflicts, %ld propagations, %d learnt "
+           "clauses\n",
+           s.decisions, s.conflicts, s.propagations, s.learnts.len);
+  }
+  cdcl_free(&s);
+  return sat;
+}
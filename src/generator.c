@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/generator.h"
+#include "../include/pattern.h"
+#include "../include/stats.h"
+#include "../include/writer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Mass generation of grids (-g --count N).
+//
+// The generator threads take the numbers of the grids from a shared counter,
+// each grid being made from its own seed and rendered in memory by the thread
+// which made it. The records are written in the order of the numbers: a
+// thread which completes the next record to write also writes the records
+// which were waiting for it. A window of pending records bounds the memory, a
+// thread more than a window ahead of the output waits for it.
+
+// Percentage of the cells given as clues, as in the generation of one grid
+#define GENERATOR_CLUES 20
+// Room of the comment line of a record
+#define RECORD_HEADER_SIZE 256
+
+typedef struct {
+  char *text; // Rendered record, NULL until the grid is made
+  size_t length;
+} t_record;
+
+typedef struct {
+  const t_generator_options *options;
+  atomic_int next; // Next grid to make
+  int written;     // Records written, under the lock
+  int window;
+  t_record *records; // Record of grid k in records[k % window]
+  t_writer *writer;
+  pthread_mutex_t lock;
+  pthread_cond_t written_cond; // Signaled when records are written
+} t_generator;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Make the grid number k and render its record. The record only depends on
+// the seed, the time of the generation goes to stderr in verbose mode.
+static t_record make_record(const t_generator_options *options, int k) {
+  uint64_t seed = options->seed + (uint64_t)k;
+  t_stats before = thread_stats;
+  double start = now();
+  t_rng rng;
+  t_grid grid;
+
+  rng_seed(&rng, seed);
+  generate_grid(options->size, GENERATOR_CLUES, &grid, options->unique, &rng,
+                0);
+  if (options->verbose) {
+    fprintf(stderr, "Grid %d generated in %.3f ms\n", k + 1,
+            (now() - start) * 1e3);
+  }
+
+  t_record record;
+  record.text = (char *)malloc(RECORD_HEADER_SIZE +
+                               GRID_TEXT_SIZE(options->size) + 1);
+  if (record.text == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the generator.\n");
+    exit(EXIT_FAILURE);
+  }
+  record.length = snprintf(
+      record.text, RECORD_HEADER_SIZE,
+      "# grid %d: size %d, seed %llu, clues %d, nodes %llu, backtracks "
+      "%llu, conflicts %llu\n",
+      k + 1, options->size, (unsigned long long)seed,
+      options->size * options->size - grid.empty_cells,
+      (unsigned long long)(thread_stats.nodes - before.nodes),
+      (unsigned long long)(thread_stats.backtracks - before.backtracks),
+      (unsigned long long)(thread_stats.conflicts - before.conflicts));
+  record.length += grid_render(&grid, record.text + record.length);
+  record.text[record.length++] = '\n';
+  grid_free(&grid);
+  return record;
+}
+
+static void *generator_main(void *arg) {
+  t_generator *generator = (t_generator *)arg;
+  const t_generator_options *options = generator->options;
+  int k;
+
+  while ((k = atomic_fetch_add(&generator->next, 1)) < options->count) {
+    pthread_mutex_lock(&generator->lock);
+    while (k >= generator->written + generator->window) {
+      pthread_cond_wait(&generator->written_cond, &generator->lock);
+    }
+    pthread_mutex_unlock(&generator->lock);
+
+    t_record record = make_record(options, k);
+
+    pthread_mutex_lock(&generator->lock);
+    generator->records[k % generator->window] = record;
+    t_record *next =
+        &generator->records[generator->written % generator->window];
+    if (next->text != NULL) {
+      while (next->text != NULL) {
+        writer_write(generator->writer, next->text, next->length);
+        free(next->text);
+        next->text = NULL;
+        generator->written++;
+        next = &generator->records[generator->written % generator->window];
+      }
+      pthread_cond_broadcast(&generator->written_cond);
+    }
+    pthread_mutex_unlock(&generator->lock);
+  }
+  // The grid buffers cached by this thread go back to the heap
+  grid_pool_release();
+  stats_flush();
+  return NULL;
+}
+
+void grid_generator_batch(FILE *output, const t_generator_options *options) {
+  // One generator per core when the number of jobs is not given
+  int jobs = options->jobs > 0 ? options->jobs
+                               : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (jobs > options->count) {
+    jobs = options->count;
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+
+  t_generator generator;
+  generator.options = options;
+  atomic_init(&generator.next, 0);
+  generator.written = 0;
+  generator.window = 16 * jobs;
+  generator.records = (t_record *)calloc(generator.window, sizeof(t_record));
+  pthread_t *threads = (pthread_t *)malloc(jobs * sizeof(pthread_t));
+  if (generator.records == NULL || threads == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the generator.\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_mutex_init(&generator.lock, NULL);
+  pthread_cond_init(&generator.written_cond, NULL);
+
+  // Tables shared by the generators are built before they start
+  line_patterns(options->size);
+
+  fprintf(output, "# %d grids of size %d%s, seeds %llu to %llu\n\n",
+          options->count, options->size,
+          options->unique ? " with a unique solution" : "",
+          (unsigned long long)options->seed,
+          (unsigned long long)(options->seed + options->count - 1));
+  fflush(output);
+  generator.writer = writer_open(output, false);
+
+  double start = now();
+  for (int w = 0; w < jobs; w++) {
+    if (pthread_create(&threads[w], NULL, generator_main, &generator) != 0) {
+      fprintf(stderr, "Error: cannot create a generator thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  for (int w = 0; w < jobs; w++) {
+    pthread_join(threads[w], NULL);
+  }
+  writer_close(generator.writer);
+  double elapsed = now() - start;
+
+  fprintf(stderr,
+          "Generated %d grids in %.3f s with %d thread%s: %.1f grids/s\n",
+          options->count, elapsed, jobs, jobs > 1 ? "s" : "",
+          elapsed > 0 ? options->count / elapsed : 0.0);
+
+  pthread_mutex_destroy(&generator.lock);
+  pthread_cond_destroy(&generator.written_cond);
+  free(generator.records);
+  free(threads);
+}
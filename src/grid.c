@@ -1,16 +1,56 @@
 #include "../include/grid.h"
+#include "../include/binformat.h"
+#include "../include/bitboard.h"
+#include "../include/cdcl.h"
+#include "../include/pattern.h"
+#include "../include/search.h"
+#include "../include/stats.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 void grid_copy(t_grid *gs, t_grid *gd) {
 
   grid_allocate(gd, gs->size); // we suppose that gd it not intialised yet
-  int loopsize = gs->size * gs->size;
-  // Perform a copy of the grid data
-  for (int i = 0; i < loopsize; i++) {
-    gd->grid[i] = gs->grid[i];
+  // The masks arrays and the sets are contiguous, one copy is enough
+  memcpy(gd->row_ones, gs->row_ones, GRID_WORDS(gs->size) * sizeof(uint64_t));
+  gd->rows_bad = gs->rows_bad;
+  gd->cols_bad = gs->cols_bad;
+  gd->dup_lines = gs->dup_lines;
+  gd->empty_cells = gs->empty_cells;
+  gd->dirty_rows = gs->dirty_rows;
+  gd->dirty_cols = gs->dirty_cols;
+}
+
+// While a trail is attached, every cell filled (by a choice or by the
+// heuristics) is recorded so that a backtrack only empties those cells again
+// instead of working on a copy of the grid. Cells must not be emptied by
+// other means while the trail is attached.
+void grid_trail_attach(t_grid *g) {
+  if (g->trail != NULL) {
+    return;
+  }
+  // Each cell can be filled at most once between two undo, the room for the
+  // size * size entries follows the masks in the grid buffer
+  g->trail = (int *)(g->row_ones + GRID_WORDS(g->size));
+  g->trail_len = 0;
+}
+
+// Empty every cell recorded after the trail had mark entries
+void grid_trail_undo(t_grid *g, int mark) {
+  int *trail = g->trail;
+  g->trail = NULL; // emptying a cell is never recorded
+  while (g->trail_len > mark) {
+    int index = trail[--g->trail_len];
+    bb_put(g, index / g->size, index % g->size, '_');
   }
+  g->trail = trail;
+}
+
+void grid_trail_detach(t_grid *g) {
+  g->trail = NULL;
+  g->trail_len = 0;
 }
 
 void set_cell(int i, int j, t_grid *g, char v) {
@@ -21,8 +61,7 @@ void set_cell(int i, int j, t_grid *g, char v) {
   if (i >= 0 && i < g->size && j >= 0 && j < g->size) {
     // Check if the provided character is valid
     if (check_char(v)) {
-      int index = i * g->size + j;
-      g->grid[index] = v;
+      bb_put(g, i, j, v);
     } else {
       fprintf(stderr, "Error: Invalid character '%c'\n", v);
       grid_free(g);
@@ -38,8 +77,7 @@ void set_cell(int i, int j, t_grid *g, char v) {
 char get_cell(int i, int j, t_grid *g) {
   // Check if the given indices are within the grid bounds
   if (i >= 0 && i < g->size && j >= 0 && j < g->size) {
-    int index = i * g->size + j;
-    return g->grid[index];
+    return bb_get(g, i, j);
   } else {
     fprintf(stderr, "Error: Invalid c ell indices (%d, %d)\n", i, j);
     grid_free(g);
@@ -47,164 +85,70 @@ char get_cell(int i, int j, t_grid *g) {
   }
 }
 
-static bool checkLinesCol(t_grid *g) {
-  for (int i = 0; i < g->size; i++) {
-    for (int j = i + 1; j < g->size; j++) {
-      bool identicalRows = true;
-      bool identicalCols = true;
-      bool hasNonEmptyCell = false;
-
-      // Check for identical rows with non-empty cells
-      for (int k = 0; k < g->size; k++) {
-        char cell1 = get_cell(i, k, g);
-        char cell2 = get_cell(j, k, g);
-
-        if (cell1 == '_' || cell2 == '_') {
-          // Skip checking if any cell is empty
-          identicalRows = false;
-          break;
-        }
-
-        hasNonEmptyCell = true;
-
-        if (cell1 != cell2) {
-          identicalRows = false;
-          break;
-        }
-      }
+// Masks of the line number l: a row when col is false, a column otherwise
+static inline uint64_t line_ones(t_grid *g, int l, bool col) {
+  return col ? g->col_ones[l] : g->row_ones[l];
+}
 
-      // Check for identical columns with non-empty cells
-      for (int k = 0; k < g->size; k++) {
-        char cell1 = get_cell(k, i, g);
-        char cell2 = get_cell(k, j, g);
-
-        if (cell1 == '_' || cell2 == '_') {
-          // Skip checking if any cell is empty
-          identicalCols = false;
-          break;
-        }
-
-        if (cell1 != cell2) {
-          identicalCols = false;
-          break;
-        }
-      }
+static inline uint64_t line_filled(t_grid *g, int l, bool col) {
+  return col ? g->col_filled[l] : g->row_filled[l];
+}
 
-      if (hasNonEmptyCell && (identicalRows || identicalCols)) {
-        return true; // Found identical lines or columns, return true
-      }
+// Set every cell of the line l whose bit is set in cells to the value v
+BB_KERNEL void fill_line(t_grid *g, int l, bool col, uint64_t cells, char v,
+                         int size) {
+  while (cells != 0) {
+    int k = __builtin_ctzll(cells);
+    cells &= cells - 1;
+    if (col) {
+      bb_put_sized(g, k, l, v, size);
+    } else {
+      bb_put_sized(g, l, k, v, size);
     }
   }
-
-  return false; // No identical lines or columns found
 }
+
 static bool is_full(t_grid *g) {
   // Check if the grid is full (no empty cells)
-  for (int i = 0; i < g->size; i++) {
-    for (int j = 0; j < g->size; j++) {
-      if (get_cell(i, j, g) == '_') {
-        return false;
-      }
-    }
-  }
-  return true;
+  return g->empty_cells == 0;
 }
-static bool equalRowLines(t_grid *g) {
-  // Check if the grid has an equal number of 1s and 0s in each row and column
-  // row
-  for (int i = 0; i < g->size; i++) {
-    int nb1 = 0, nb0 = 0;
-    for (int j = 0; j < g->size; j++) {
 
-      if (get_cell(i, j, g) != '0') {
-        nb0++;
-      }
-
-      if (get_cell(i, j, g) != '1') {
-        nb1++;
-      }
-    }
-
-    if (nb0 != nb1) {
-      return false;
-    }
+// Print why the grid is inconsistent, only used in verbose mode
+static void print_inconsistency(t_grid *g) {
+  fprintf(stdout, "######################################################\n");
+  if (g->dup_lines > 0) {
+    fprintf(stdout, "Two identical (rows | columns) found in this grid\n");
+    return;
   }
 
-  // column
-
-  for (int i = 0; i < g->size; i++) {
-    int nb1 = 0, nb0 = 0;
-    for (int j = 0; j < g->size; j++) {
+  bool col = g->rows_bad == 0;
+  int l = __builtin_ctzll(col ? g->cols_bad : g->rows_bad);
+  uint64_t ones = line_ones(g, l, col);
+  uint64_t zeros = bb_zeros(ones, line_filled(g, l, col));
+  const char *line = col ? "column" : "row";
 
-      if (get_cell(j, i, g) != '0') {
-        nb0++;
-      }
-
-      if (get_cell(j, i, g) != '1') {
-        nb1++;
-      }
-    }
-
-    if (nb0 != nb1) {
-      return false;
-    }
+  if (bb_triples(ones) != 0 || bb_triples(zeros) != 0) {
+    fprintf(stdout, "More than two consecutives %c found in the %s %d\n",
+            bb_triples(ones) != 0 ? '1' : '0', line, l + 1);
+  } else {
+    fprintf(stdout, "More than %d %c found in the %s %d\n", g->size / 2,
+            bb_popcount(ones) > g->size / 2 ? '1' : '0', line, l + 1);
   }
-  return true;
 }
 
+// The line state is updated by every write of a cell (see bb_put), so the
+// check does not need to scan the grid
 bool is_consistent(t_grid *g, int verbose) {
-  if (checkLinesCol(g)) {
-    if (verbose) {
-      fprintf(stdout,
-              "######################################################\n");
-      fprintf(stdout, "Two identical (rows | columns) found in this grid\n");
-    }
+  if (g->row_ones == NULL) {
     return false;
   }
 
-  if (g->grid == NULL) {
-    return false;
-  }
-
-  // Check for more than two consecutive zeros or ones in rows and columns
-  for (int i = 0; i < g->size; i++) {
-    for (int j = 0; j < g->size; j++) {
-      // Check rows
-      if (get_cell(i, j, g) != '_') {
-        int k = j + 1;
-        int l = k + 1;
-        if (l < g->size && (get_cell(i, j, g) == get_cell(i, k, g)) &&
-            get_cell(i, k, g) == get_cell(i, l, g)) {
-          if (verbose) {
-            fprintf(stdout,
-                    "######################################################\n");
-            fprintf(stdout,
-                    "More than two consecutives %c found in the row %d\n",
-                    get_cell(i, j, g), i + 1);
-          }
-          return false;
-        }
-      }
-
-      // Check columns
-      if (get_cell(j, i, g) != '_') {
-        int k = j + 1;
-        int l = k + 1;
-        if (l < g->size && (get_cell(j, i, g) == get_cell(k, i, g)) &&
-            get_cell(k, i, g) == get_cell(l, i, g)) {
-          if (verbose) {
-            fprintf(stdout,
-                    "######################################################\n");
-            fprintf(stdout,
-                    "More than two consecutives %c found in the row %d\n",
-                    get_cell(k, i, g), i + 1);
-          }
-          return false;
-        }
-      }
+  thread_stats.checks++;
+  if (g->rows_bad != 0 || g->cols_bad != 0 || g->dup_lines > 0) {
+    stats_conflict();
+    if (verbose) {
+      print_inconsistency(g);
     }
-  }
-  if (is_full(g) && !equalRowLines(g)) {
     return false;
   }
   // The grid is consistent
@@ -212,273 +156,133 @@ bool is_consistent(t_grid *g, int verbose) {
 }
 
 bool is_valid(t_grid *g) {
-  // Check if the grid is full (no empty cells)
-  for (int i = 0; i < g->size; i++) {
-    for (int j = 0; j < g->size; j++) {
-      if (get_cell(i, j, g) == '_') {
-        return false;
-      }
-    }
-  }
+  // A full consistent grid has as many 1s as 0s in each row and column since
+  // no line holds more than size / 2 of each
+  return is_full(g) && is_consistent(g, 0);
+}
 
-  // Check if the grid is consistent
-  if (!is_consistent(g, 0)) {
+// Cells of a line forced by the heuristics:
+// - the cells right before and right after two equal values get the other
+//   value (00 -> 1001), as well as a cell between two equal values (0_0);
+// - when a line already holds size / 2 of a value, its empty cells get the
+//   other one (this also covers a line with a single empty cell).
+// Returns false when a cell is forced to both values.
+BB_KERNEL bool line_heuristics(uint64_t ones, uint64_t filled,
+                               uint64_t *to_one, uint64_t *to_zero,
+                               int size) {
+  uint64_t empty = bb_line_mask(size) & ~filled;
+  uint64_t zeros = bb_zeros(ones, filled);
+  // Bit k of a pair mask is set when cells k and k + 1 hold the same value,
+  // bit k of a gap mask when cells k and k + 2 do
+  uint64_t pairs1 = ones & (ones >> 1);
+  uint64_t pairs0 = zeros & (zeros >> 1);
+  uint64_t gaps1 = ones & (ones >> 2);
+  uint64_t gaps0 = zeros & (zeros >> 2);
+
+  *to_zero = ((pairs1 << 2) | (pairs1 >> 1) | (gaps1 << 1)) & empty;
+  *to_one = ((pairs0 << 2) | (pairs0 >> 1) | (gaps0 << 1)) & empty;
+  if (bb_popcount(zeros) == size / 2) {
+    *to_one |= empty;
+  }
+  if (bb_popcount(ones) == size / 2) {
+    *to_zero |= empty;
+  }
+  if ((*to_one & *to_zero) != 0) {
     return false;
   }
-
-  if (!equalRowLines(g)) {
-    return false;
+  if (stats_enabled) {
+    // Each cell is counted for the first rule which fills it
+    uint64_t pair =
+        ((pairs1 << 2) | (pairs1 >> 1) | (pairs0 << 2) | (pairs0 >> 1)) & empty;
+    uint64_t gap = ((gaps1 | gaps0) << 1) & empty & ~pair;
+    uint64_t half = (*to_one | *to_zero) & ~pair & ~gap;
+    thread_stats.propagated[RULE_PAIR] += bb_popcount(pair);
+    thread_stats.propagated[RULE_GAP] += bb_popcount(gap);
+    thread_stats.propagated[RULE_HALF] += bb_popcount(half);
   }
-
-  // The grid is valid
   return true;
 }
 
-bool one_possible_value_heuristic(t_grid *g) {
-  bool is_modified = false;
-
-  // Check each row for single candidate
-  for (int i = 0; i < g->size; i++) {
-    int empty_cell_count = 0;
-    int empty_cell_index = -1;
-    int zero_count = 0;
-    int one_count = 0;
-
-    // Count the number of empty cells and find the index of the first empty
-    // cell
-    for (int j = 0; j < g->size; j++) {
-      if (get_cell(i, j, g) == '_') {
-        empty_cell_count++;
-        empty_cell_index = j;
-      } else if (get_cell(i, j, g) == '0') {
-        zero_count++;
-      } else if (get_cell(i, j, g) == '1') {
-        one_count++;
-      }
-    }
-
-    // If there is only one empty cell and the counts of zeros and ones are not
-    // equal
-    if (empty_cell_count == 1 && zero_count != one_count) {
-      // Fill the empty cell with the opposite value
-      char opposite_value = (zero_count > one_count) ? '1' : '0';
-      set_cell(i, empty_cell_index, g, opposite_value);
-      is_modified = true;
+// Propagate the rules from the lines marked dirty by the last writes of cells
+// (see bb_put) until no line is dirty. Only a line whose cells changed is
+// examined again, so the cost follows the number of cells set rather than the
+// size of the grid. Sizes 4, 8 and 16 use the tables of valid lines, which
+// cover the heuristics; 32 and 64 use the heuristics. Returns false as soon as
+// a conflict is found, the grid cannot be solved.
+BB_KERNEL bool propagate(t_grid *grid, int size) {
+  const t_line_patterns *patterns = line_patterns(size);
+  uint64_t full = bb_line_mask(size);
+
+  while ((grid->dirty_rows | grid->dirty_cols) != 0) {
+    if (grid->rows_bad != 0 || grid->cols_bad != 0 || grid->dup_lines > 0) {
+      return false;
     }
-  }
 
-  // Check each column for single candidate
-  for (int j = 0; j < g->size; j++) {
-    int empty_cell_count = 0;
-    int empty_cell_index = -1;
-    int zero_count = 0;
-    int one_count = 0;
-
-    // Count the number of empty cells and find the index of the first empty
-    // cell
-    for (int i = 0; i < g->size; i++) {
-      if (get_cell(i, j, g) == '_') {
-        empty_cell_count++;
-        empty_cell_index = i;
-      } else if (get_cell(i, j, g) == '0') {
-        zero_count++;
-      } else if (get_cell(i, j, g) == '1') {
-        one_count++;
-      }
-    }
+    // Rows first, then columns
+    bool col = grid->dirty_rows == 0;
+    uint64_t *dirty = col ? &grid->dirty_cols : &grid->dirty_rows;
+    int l = __builtin_ctzll(*dirty);
+    *dirty &= *dirty - 1;
 
-    // If there is only one empty cell and the counts of zeros and ones are
-    // notequal
-    if (empty_cell_count == 1 && zero_count != one_count) {
-      // Fill the empty cell with the opposite value
-      char opposite_value = (zero_count > one_count) ? '1' : '0';
-      set_cell(empty_cell_index, j, g, opposite_value);
-      is_modified = true;
+    uint64_t ones = line_ones(grid, l, col);
+    uint64_t filled = line_filled(grid, l, col);
+    if (filled == full) {
+      continue;
     }
-  }
 
-  return is_modified;
-}
-
-bool check_consecutive_heuristic(t_grid *g) {
-  bool is_modified = false;
-  // Check rows
-  for (int i = 0; i < g->size; i++) {
-    for (int j = 0; j < g->size - 2; j++) {
-      if (get_cell(i, j, g) == '0' && get_cell(i, j + 1, g) == '0') {
-        if (get_cell(i, j + 2, g) == '_') {
-          set_cell(i, j + 2, g, '1');
-          is_modified = true;
-        }
-        if (j > 0) {
-          if (get_cell(i, j - 1, g) == '_') {
-            set_cell(i, j - 1, g, '1');
-            is_modified = true;
-          }
-        }
-
-      } else if (get_cell(i, j, g) == '1' && get_cell(i, j + 1, g) == '1') {
-        if (get_cell(i, j + 2, g) == '_') {
-          set_cell(i, j + 2, g, '0');
-          is_modified = true;
-        }
-        if (j > 0) {
-          if (get_cell(i, j - 1, g) == '_') {
-            set_cell(i, j - 1, g, '0');
-            is_modified = true;
-          }
-        }
-      }
-    }
-    // Manage two last cells of a given row
-    if (get_cell(i, g->size - 2, g) == '1' &&
-        get_cell(i, g->size - 1, g) == '1') {
-      if (get_cell(i, g->size - 3, g) == '_') {
-        set_cell(i, g->size - 3, g, '0');
-        is_modified = true;
-      }
-    }
-    if (get_cell(i, g->size - 2, g) == '0' &&
-        get_cell(i, g->size - 1, g) == '0') {
-      if (get_cell(i, g->size - 3, g) == '_') {
-        set_cell(i, g->size - 3, g, '1');
-        is_modified = true;
-      }
-    }
-  }
-
-  // Check columns
-  for (int j = 0; j < g->size; j++) {
-    for (int i = 0; i < g->size - 2; i++) {
-      if (get_cell(i, j, g) == '0' && get_cell(i + 1, j, g) == '0') {
-        if (get_cell(i + 2, j, g) == '_') {
-          set_cell(i + 2, j, g, '1');
-          is_modified = true;
-        }
-        if (i > 0) {
-          if (get_cell(i - 1, j, g) == '_') {
-            set_cell(i - 1, j, g, '1');
-            is_modified = true;
-          }
-        }
-      } else if (get_cell(i, j, g) == '1' && get_cell(i + 1, j, g) == '1') {
-        if (get_cell(i + 2, j, g) == '_') {
-          set_cell(i + 2, j, g, '0');
-          is_modified = true;
-        }
-        if (i > 0) {
-          if (get_cell(i - 1, j, g) == '_') {
-            set_cell(i - 1, j, g, '0');
-            is_modified = true;
-          }
-        }
-      }
+    uint64_t to_one, to_zero;
+    bool feasible;
+    if (patterns != NULL) {
+      feasible = line_patterns_infer(patterns, ones, filled,
+                                     col ? grid->full_cols : grid->full_rows,
+                                     &to_one, &to_zero);
+    } else {
+      feasible = line_heuristics(ones, filled, &to_one, &to_zero, size);
     }
-    // Manage two last cells of a given column
-    if (get_cell(g->size - 2, j, g) == '1' &&
-        get_cell(g->size - 1, j, g) == '1') {
-      if (get_cell(g->size - 3, j, g) == '_') {
-        set_cell(g->size - 3, j, g, '0');
-        is_modified = true;
-      }
+    if (!feasible) {
+      return false;
     }
-    if (get_cell(g->size - 2, j, g) == '0' &&
-        get_cell(g->size - 1, j, g) == '0') {
-      if (get_cell(g->size - 3, j, g) == '_') {
-        set_cell(g->size - 3, j, g, '1');
-        is_modified = true;
-      }
+    if (patterns != NULL) {
+      thread_stats.propagated[RULE_TABLE] += bb_popcount(to_one | to_zero);
     }
+    // Filling the cells marks their crossing lines (and this one) dirty
+    fill_line(grid, l, col, to_one, '1', size);
+    fill_line(grid, l, col, to_zero, '0', size);
   }
-
-  return is_modified;
+  return grid->rows_bad == 0 && grid->cols_bad == 0 && grid->dup_lines == 0;
 }
 
-bool filled_empty_cell_heuristic(t_grid *g) {
-  bool is_modified = false;
-
-  // Check rows
-  for (int i = 0; i < g->size; i++) {
-    int nbZeros = 0;
-    int nbOnes = 0;
-    int nbEmpty = 0;
-
-    for (int j = 0; j < g->size; j++) {
-      char cell = get_cell(i, j, g);
-      if (cell == '0') {
-        nbZeros++;
-      } else if (cell == '1') {
-        nbOnes++;
-      } else if (cell == '_') {
-        nbEmpty++;
-      }
-    }
-
-    // if (nbZeros == g->size - nbEmpty)
-    if (nbZeros == g->size / 2) {
-      for (int j = 0; j < g->size; j++) {
-        if (get_cell(i, j, g) == '_') {
-          set_cell(i, j, g, '1');
-          is_modified = true;
-        }
-      }
-    } else if (nbOnes == g->size / 2) {
-      for (int j = 0; j < g->size; j++) {
-        if (get_cell(i, j, g) == '_') {
-          set_cell(i, j, g, '0');
-          is_modified = true;
-        }
-      }
-    }
-  }
-
-  // Check columns
-  for (int j = 0; j < g->size; j++) {
-    int nbZeros = 0;
-    int nbOnes = 0;
-    int nbEmpty = 0;
-
-    for (int i = 0; i < g->size; i++) {
-      char cell = get_cell(i, j, g);
-      if (cell == '0') {
-        nbZeros++;
-      } else if (cell == '1') {
-        nbOnes++;
-      } else if (cell == '_') {
-        nbEmpty++;
-      }
-    }
-
-    if (nbZeros == g->size / 2) {
-      for (int i = 0; i < g->size; i++) {
-        if (get_cell(i, j, g) == '_') {
-          set_cell(i, j, g, '1');
-          is_modified = true;
-        }
-      }
-    } else if (nbOnes == g->size / 2) {
-      for (int i = 0; i < g->size; i++) {
-        if (get_cell(i, j, g) == '_') {
-          set_cell(i, j, g, '0');
-          is_modified = true;
-        }
-      }
-    }
+BB_DISPATCH bool stabilise_with_heuristics(t_grid *grid) {
+  double start = stats_clock();
+  bool feasible;
+  switch (grid->size) {
+  case 4:
+    feasible = propagate(grid, 4);
+    break;
+  case 8:
+    feasible = propagate(grid, 8);
+    break;
+  case 16:
+    feasible = propagate(grid, 16);
+    break;
+  case 32:
+    feasible = propagate(grid, 32);
+    break;
+  case 64:
+    feasible = propagate(grid, 64);
+    break;
+  default:
+    feasible = propagate(grid, grid->size);
   }
-
-  return is_modified;
-}
-
-void stabilise_with_heuristics(t_grid *grid) {
-
-  while (check_consecutive_heuristic(grid) ||
-         filled_empty_cell_heuristic(grid) ||
-         one_possible_value_heuristic(grid)) {
-    ;
+  stats_time(PHASE_PROPAGATION, start);
+  if (!feasible) {
+    stats_conflict();
   }
+  return feasible;
 }
 
 void grid_choice_apply(t_grid *grid, const choice_t choice) {
+  stats_node();
   set_cell(choice.row, choice.column, grid, choice.choice);
 }
 
@@ -488,453 +292,562 @@ void grid_choice_print(const choice_t choice, FILE *fd) {
           choice.column + 1, choice.choice);
 }
 
-choice_t grid_choice(t_grid *grid) {
-  choice_t choice;
-  choice.row = -1;
-  choice.column = -1;
-  choice.choice = '_';
-
-  // Iterate through each cell in the grid
-  for (int i = 0; i < grid->size; i++) {
-    for (int j = 0; j < grid->size; j++) {
-      // Check if the cell is empty
-      if (get_cell(i, j, grid) == '_') {
-        // Set the choice to '0' and check if it makes the grid inconsistent
-        set_cell(i, j, grid, '0');
-        if (is_consistent(grid, 0)) {
-          choice.row = i;
-          choice.column = j;
-          choice.choice = '0';
-          return choice;
-        }
-
-        // Set the choice to '1' and check if it makes the grid inconsistent
-        set_cell(i, j, grid, '1');
-        if (is_consistent(grid, 0)) {
-          choice.row = i;
-          choice.column = j;
-          choice.choice = '1';
-          return choice;
-        }
-
-        // Reset the cell back to empty
-        // set_cell(i, j, grid, '_');
+// Number of empty cells of a line
+static inline int line_empty(t_grid *g, int l, bool col, int size) {
+  return size - bb_popcount(line_filled(g, l, col));
+}
+
+// Most constrained empty cell: the row or the column with the fewest empty
+// cells is taken, and in it the cell whose crossing line has the fewest empty
+// cells. Only the masks are read, the cost is O(size). row is -1 when the grid
+// is full.
+BB_KERNEL choice_t choice_cell(t_grid *grid, int size) {
+  choice_t choice = {-1, -1, '_'};
+  int best_line = -1;
+  bool best_col = false;
+  int best_empty = size + 1;
+
+  for (int col = 0; col <= 1; col++) {
+    for (int l = 0; l < size; l++) {
+      int empty = line_empty(grid, l, col, size);
+      if (empty > 0 && empty < best_empty) {
+        best_empty = empty;
+        best_line = l;
+        best_col = col;
       }
     }
   }
+  if (best_line == -1) {
+    return choice;
+  }
 
+  uint64_t empty = bb_line_mask(size) & ~line_filled(grid, best_line,
+                                                     best_col);
+  int best_cross = size + 1;
+  while (empty != 0) {
+    int k = __builtin_ctzll(empty);
+    empty &= empty - 1;
+    int cross = line_empty(grid, k, !best_col, size);
+    if (cross < best_cross) {
+      best_cross = cross;
+      choice.row = best_col ? k : best_line;
+      choice.column = best_col ? best_line : k;
+    }
+  }
   return choice;
 }
 
-static choice_t secondChoice(choice_t choice) {
-  choice_t other_choice;
-  other_choice = choice;
-  switch (choice.choice) {
-  case '0':
-    other_choice.choice = '1';
-    break;
-  case '1':
-    other_choice.choice = '0';
+BB_DISPATCH choice_t grid_choice_cell(t_grid *grid) {
+  switch (grid->size) {
+  case 4:
+    return choice_cell(grid, 4);
+  case 8:
+    return choice_cell(grid, 8);
+  case 16:
+    return choice_cell(grid, 16);
+  case 32:
+    return choice_cell(grid, 32);
+  case 64:
+    return choice_cell(grid, 64);
+  default:
+    return choice_cell(grid, grid->size);
   }
-  return other_choice;
 }
-// Search for all possible solutions and return the grid found
-static t_grid *seek_for_solution(t_grid *grid, int *nb, int verbose) {
-  if (*nb == 1) {
-    return grid;
-  }
 
-  if (is_valid(grid)) {
-    *nb += 1;
-    return grid;
-  }
+// How many more times the row and the column of a cell miss a 1 than a 0
+static int value_demand(t_grid *grid, int i, int j) {
+  int ones = bb_popcount(grid->row_ones[i]) + bb_popcount(grid->col_ones[j]);
+  int zeros = bb_popcount(grid->row_filled[i]) +
+              bb_popcount(grid->col_filled[j]) - ones;
 
-  if (!is_consistent(grid, verbose)) {
-    if (verbose) {
-      printf("Inconsistent grid!, exploring other remaining paths...\n");
-      grid_print(grid, stdout);
-    }
-    grid_free(grid);
-    return NULL;
-  }
+  return zeros - ones;
+}
+
+// Value the row and the column of an empty cell need the most: the one still
+// missing the most times in both lines ('0' on a tie)
+char grid_choice_value(t_grid *grid, int i, int j) {
+  return value_demand(grid, i, j) > 0 ? '1' : '0';
+}
 
-  choice_t choice;
-  choice_t otherChoice;
-  t_grid gridCopy1;
-  t_grid gridCopy2;
-  grid_copy(grid, &gridCopy1);
-  choice = grid_choice(&gridCopy1);
-  // If choice.row == -1, it means (according to our implementation) that no
-  // choice will lead to a consistent grid therefore the grid is inconstent
+// Choose the most constrained empty cell and the value it needs the most. The
+// grid is left unchanged: each probe is undone before returning. row is -1
+// when the chosen cell accepts no value.
+choice_t grid_choice(t_grid *grid) {
+  choice_t choice = grid_choice_cell(grid);
   if (choice.row == -1) {
-    return false;
+    return choice;
   }
-  grid_copy(&gridCopy1, &gridCopy2);
-  grid_choice_apply(&gridCopy1, choice);
-  // Applying heuristics
-  stabilise_with_heuristics(&gridCopy1);
 
-  if (is_consistent(&gridCopy1, 0)) {
-    t_grid *result = seek_for_solution(&gridCopy1, nb, verbose);
-    if (result != NULL) {
-      return result;
+  char first = grid_choice_value(grid, choice.row, choice.column);
+  char values[2] = {first, first == '0' ? '1' : '0'};
+
+  // Probes are not recorded on the trail
+  int *trail = grid->trail;
+  grid->trail = NULL;
+  for (int v = 0; v < 2 && choice.choice == '_'; v++) {
+    set_cell(choice.row, choice.column, grid, values[v]);
+    if (is_consistent(grid, 0)) {
+      choice.choice = values[v];
     }
   }
+  // Reset the cell back to empty
+  set_cell(choice.row, choice.column, grid, '_');
+  grid->trail = trail;
 
-  otherChoice = secondChoice(choice);
-
-  set_cell(otherChoice.row, otherChoice.column, &gridCopy2, '_');
-  grid_choice_apply(&gridCopy2, otherChoice);
-  stabilise_with_heuristics(&gridCopy2);
-
-  return seek_for_solution(&gridCopy2, nb, verbose);
+  // If no value fits this cell, no choice will lead to a consistent grid
+  if (choice.choice == '_') {
+    choice.row = -1;
+    choice.column = -1;
+  }
+  return choice;
 }
-// Check if the grid has only one solution or not in order to generate a grid
-// with one solution
-static bool is_there_any_other_solution(t_grid *grid, int *nb, int verbose) {
 
-  if (is_valid(grid)) {
-    *nb += 1;
-    if (verbose) {
-      printf("Consistent grid!, Number of solutions found %d\n", *nb);
-      grid_print(grid, stdout);
-    }
-    grid_free(grid);
-    return true;
-  }
+// Count the solutions without printing them, the search stops as soon as
+// limit solutions are found (no limit when limit <= 0)
+static int count_solutions(t_grid *grid, int limit) {
+  t_search search;
+  int nb = 0;
 
-  if (!is_consistent(grid, verbose)) {
-    if (verbose) {
-      printf("Inconsistent grid!, exploring other remaining paths...\n");
-      grid_print(grid, stdout);
-    }
-    grid_free(grid);
-    return false;
+  dfs_init(&search, grid);
+  while ((limit <= 0 || nb < limit) && dfs_next(&search) == 1) {
+    nb++;
   }
+  dfs_free(&search);
+  return nb;
+}
 
-  choice_t choice;
-  choice_t otherChoice;
-  t_grid gridCopy1;
-  t_grid gridCopy2;
+int grid_count_solutions(t_grid *grid, int limit) {
+  bool attached = grid->trail != NULL;
+  int mark = grid->trail_len;
+  int nb = 0;
 
-  grid_copy(grid, &gridCopy1);
-  grid_copy(grid, &gridCopy2);
-  choice = grid_choice(&gridCopy1);
-  // If choice.row == -1, it means (according to our implementation) that no
-  // choice will lead to a consistent grid therefore the grid is inconstent
+  grid_trail_attach(grid);
+  if (stabilise_with_heuristics(grid)) {
+    nb = count_solutions(grid, limit);
+  }
+  grid_trail_undo(grid, mark);
+  if (!attached) {
+    grid_trail_detach(grid);
+  }
+  return nb;
+}
+// Number of choices after which the searches of the generator give up: per
+// cell of the grid for the sampling of a solution, per removal test for the
+// removal of a clue. Nearly every clue which can be removed is proven so by
+// the propagation after a few choices, a longer removal test rarely pays off
+// on large grids.
+#define SAMPLING_NODE_BUDGET 2
+#define REMOVAL_NODE_BUDGET 64
+
+// Choice of random_solution: the value is drawn at random when the lines of
+// the cell need both values as much
+static choice_t random_choice(t_grid *grid, void *data) {
+  choice_t choice = grid_choice_cell(grid);
   if (choice.row == -1) {
-    return false;
+    return choice;
   }
-  // Save the second choice in case we want to do backtracking
-  otherChoice = secondChoice(choice);
-  grid_choice_apply(&gridCopy1, choice);
-
-  if (is_consistent(&gridCopy1, 0)) {
-    stabilise_with_heuristics(&gridCopy1);
-    is_there_any_other_solution(&gridCopy1, nb, verbose);
+  int demand = value_demand(grid, choice.row, choice.column);
+  if (demand == 0) {
+    choice.choice = rng_bool((t_rng *)data) ? '1' : '0';
+  } else {
+    choice.choice = demand > 0 ? '1' : '0';
   }
+  return choice;
+}
 
-  set_cell(otherChoice.row, otherChoice.column, &gridCopy2, '_');
-
-  grid_choice_apply(&gridCopy2, otherChoice);
+// Search a solution with the values of the choices drawn by random_choice, so
+// that each call samples a different solution. The grid is solved in place.
+// A bad early draw can trap the search in a large subtree without solution,
+// so it gives up after a budget of choices and the caller starts again.
+// Returns 1 when a solution is found, 0 when there is none, -1 when the
+// budget is exhausted.
+static int random_solution(t_grid *grid, t_rng *rng, int budget) {
+  t_search search;
+  dfs_init(&search, grid);
+  search.choose = random_choice;
+  search.data = rng;
+  search.budget = budget;
+  int result = dfs_next(&search);
+  dfs_free(&search);
+  return result;
+}
 
-  if (is_consistent(&gridCopy2, 0)) {
-    stabilise_with_heuristics(&gridCopy2);
-    is_there_any_other_solution(&gridCopy2, nb, verbose);
+// Choice of seeded_solution: the value of the known solution first
+static choice_t seeded_choice(t_grid *grid, void *data) {
+  choice_t choice = grid_choice_cell(grid);
+  if (choice.row != -1) {
+    choice.choice = bb_get((const t_grid *)data, choice.row, choice.column);
   }
-
-  return false;
+  return choice;
 }
-// Search for a grid which have only one solution
-t_grid *generateUniqueSolution(t_grid *grid, int verbose) {
 
-  srand(time(NULL));
-  int nb = 0;
-  t_grid grid2;
-  // Search a grid having at least one solution
-  grid_copy(seek_for_solution(grid, &nb, verbose), &grid2);
-  grid_free(grid);
-  int size = grid2.size;
-  // Seach for grid having having only one solution
-  while (nb < 2) {
-    nb = 0;
-    int i, j;
-
-    i = rand() % size;
-    j = rand() % size;
-
-    while (get_cell(i, j, &grid2) == '_') {
-      i = rand() % size;
-      j = rand() % size;
-    }
-    char tmp = get_cell(i, j, &grid2);
+// Search of a solution other than the known one, used by the generator.
+// Choices try the value of the known solution first: another solution, when
+// there is one, usually differs from it in a few cells only. Proving that
+// there is none can be very long on large grids, the search gives up after a
+// budget of choices. Returns 1 when a solution is found, 0 when there is
+// none, -1 when the budget is exhausted. The grid is given back unchanged.
+static int seeded_solution(t_grid *grid, const t_grid *known, int budget) {
+  t_search search;
+  int mark = grid->trail_len;
+  dfs_init(&search, grid);
+  search.choose = seeded_choice;
+  search.data = (void *)known;
+  search.budget = budget;
+  int result = dfs_next(&search);
+  dfs_free(&search);
+  grid_trail_undo(grid, mark);
+  return result;
+}
 
-    set_cell(i, j, &grid2, '_');
+// Indexes of the nb_cells cells of a grid in a random order, to be freed
+static int *shuffled_cells(int nb_cells, t_rng *rng) {
+  int *cells = (int *)malloc(nb_cells * sizeof(int));
+  if (cells == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the generation.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int k = 0; k < nb_cells; k++) {
+    cells[k] = k;
+  }
+  for (int k = nb_cells - 1; k > 0; k--) {
+    int r = (int)rng_below(rng, k + 1);
+    int tmp = cells[k];
+    cells[k] = cells[r];
+    cells[r] = tmp;
+  }
+  return cells;
+}
 
-    t_grid gridCopy;
-    grid_copy(&grid2, &gridCopy);
-    is_there_any_other_solution(&gridCopy, &nb, verbose);
-    // If nb == 1 this means that the number of solution is 1, we found what we
-    // searched for
-    if (nb == 1) {
+// Whether the clue of cell (i, j), of the given value, is needed for the grid
+// to keep a single solution: the grid with the opposite value in the cell has
+// a solution. With a budget the search may give up (-1), without one the
+// clause learning engine gives a definite answer (0 or 1).
+static int clue_needed(t_grid *grid, int i, int j, char value,
+                       const t_grid *solution, int budget) {
+  int result;
+  bb_put(grid, i, j, '_');
+  bb_put(grid, i, j, value == '0' ? '1' : '0');
+  grid_trail_attach(grid);
+  if (!stabilise_with_heuristics(grid)) {
+    result = 0;
+  } else if (budget > 0) {
+    result = seeded_solution(grid, solution, budget);
+  } else {
+    t_grid other;
+    result = cdcl_solve(grid, &other, 0);
+    if (result) {
+      grid_free(&other);
+    }
+  }
+  grid_trail_undo(grid, 0);
+  grid_trail_detach(grid);
+  bb_put(grid, i, j, '_');
+  bb_put(grid, i, j, value);
+  return result;
+}
 
-      ;
-    } else {
-      // else we change the value of the cell and we continue searching
-      set_cell(i, j, &grid2, tmp);
-      grid_copy(&grid2, grid);
+// Generate a grid with a unique solution: a random solution is sampled, then
+// its cells are removed in a random order. A clue can go when the grid with
+// the opposite value in its cell has no solution: the sampled solution is
+// then the only one left. The removals stop when the clues are down to N % of
+// the cells. The test of each clue first runs under a budget of choices;
+// the clues whose test gave up are tested again by the clause learning
+// engine at the end, so that when the target is not reached the grid is
+// minimal (no clue can be removed).
+static void generate_unique_grid(t_grid *grid, int N, t_rng *rng,
+                                 int verbose) {
+  int size = grid->size;
+  int nb_cells = size * size;
+  int nb_clues = nb_cells;
+  int target = (N * nb_cells) / 100;
+
+  grid_trail_attach(grid);
+  while (random_solution(grid, rng, SAMPLING_NODE_BUDGET * nb_cells) != 1) {
+    grid_trail_undo(grid, 0);
+  }
+  grid_trail_detach(grid);
+  t_grid solution;
+  grid_copy(grid, &solution);
+
+  int *cells = shuffled_cells(nb_cells, rng);
+  // The cells whose test gave up are moved to the front of cells
+  int nb_doubtful = 0;
+
+  for (int k = 0; k < nb_cells && nb_clues > target; k++) {
+    int i = cells[k] / size;
+    int j = cells[k] % size;
+    char value = bb_get(grid, i, j);
+    // A single solution with the opposite value is enough to keep the clue
+    int needed =
+        clue_needed(grid, i, j, value, &solution, REMOVAL_NODE_BUDGET);
+    if (needed == 0) {
+      bb_put(grid, i, j, '_');
+      nb_clues--;
+    } else if (needed == -1) {
+      cells[nb_doubtful++] = cells[k];
+    }
+  }
+  // A clue needed once stays needed as other clues go, only the doubtful
+  // ones are tested again
+  for (int k = 0; k < nb_doubtful && nb_clues > target; k++) {
+    int i = cells[k] / size;
+    int j = cells[k] % size;
+    if (!clue_needed(grid, i, j, bb_get(grid, i, j), &solution, 0)) {
+      bb_put(grid, i, j, '_');
+      nb_clues--;
+    }
+  }
+  free(cells);
+  grid_free(&solution);
 
-      return grid;
-    }
+  if (verbose) {
+    printf("Unique grid generated with %d clues out of %d cells\n", nb_clues,
+           nb_cells);
   }
+}
 
-  return NULL;
+void grid_first_solution_print(t_grid *grid, FILE *output) {
+  fprintf(output, "######################################################\n");
+  fprintf(output, "Solution found\n");
+  grid_print(grid, output);
+  fprintf(output, "\n\n");
 }
 
-static bool has_solution(t_grid *grid, FILE *output, int verbose, int unique) {
-  if (is_valid(grid)) {
-    if (!unique) {
-      fprintf(output,
-              "######################################################\n");
-      fprintf(output, "Solution found\n");
-      grid_print(grid, output);
-      fprintf(output, "\n\n");
-    }
-    grid_free(grid);
-    // exit(EXIT_SUCCESS);
-    return true;
-  }
+// Search for a first solution, the grid is solved in place when one is found
+static bool has_solution(t_grid *grid, int verbose) {
+  t_search search;
+  dfs_init(&search, grid);
+  search.verbose = verbose;
+  bool found = dfs_next(&search) == 1;
+  dfs_free(&search);
+  return found;
+}
 
-  if (!is_consistent(grid, verbose) || is_full(grid)) {
-    if (verbose) {
-      printf("######################################################\n");
-      printf("Inconsistent grid!, exploring other remaining paths...\n");
-      grid_print(grid, stdout);
+bool grid_solve(t_grid *grid, const t_engine engine) {
+  if (engine == ENGINE_CDCL) {
+    t_grid solution;
+    if (!cdcl_solve(grid, &solution, 0)) {
+      return false;
     }
     grid_free(grid);
-    return false;
+    *grid = solution;
+    return true;
   }
 
-  // Other make a choice and continue exploring
-  choice_t choice;
-  choice_t other_choice;
-  t_grid gridCopy1;
-  t_grid gridCopy2;
-  grid_copy(grid, &gridCopy1); // gridCopy1 is used to explore one path
-  grid_copy(grid, &gridCopy2); // gridCopy2 is used to explore the remaining
-  choice = grid_choice(&gridCopy1);
-  // If choice.row == -1, it means (according to our implementation) that no
-  // choice will lead to a consistent grid therefore the grid is inconstent
-  if (choice.row == -1) {
-    return false;
+  grid_trail_attach(grid);
+  bool solved =
+      stabilise_with_heuristics(grid) && has_solution(grid, 0);
+  if (!solved) {
+    grid_trail_undo(grid, 0);
   }
-  // Save the second choice in case we want to do backtracking
-  other_choice = secondChoice(choice);
+  grid_trail_detach(grid);
+  return solved;
+}
 
-  if (verbose) {
-    printf("######################################################\n");
-    printf("Choice made....\n");
-    grid_choice_print(choice, stdout);
-  }
-  grid_choice_apply(&gridCopy1, choice);
-  // Applying heuristics
-  if (is_consistent(&gridCopy1, 0)) {
-    stabilise_with_heuristics(&gridCopy1);
+// Place N % of the cells as clues, in random cells and alternately 0 and 1.
+// The clues are also set in a working grid where they are propagated: a cell
+// which the propagation fills is implied by the clues and is not drawn, and a
+// value which the propagation proves wrong is not placed, the cell gets the
+// other one. Every draw is thus allowed by the clues placed so far, and the
+// grid ends up solvable unless the propagation misses a contradiction, which
+// the clause learning engine then rules out. Returns false, g being freed,
+// when the clues have no solution.
+static bool grid_constructor(int size, t_grid *g, int N, t_rng *rng,
+                             int *nb_clues) {
+  int nb_cells = size * size;
+  int target = (N * nb_cells) / 100;
+  int *cells = shuffled_cells(nb_cells, rng);
+  t_grid work;
+  bool solvable = true;
+
+  //  allocate the grids, every cell is initialised as empty
+  grid_allocate(g, size);
+  grid_allocate(&work, size);
+  grid_trail_attach(&work);
+  *nb_clues = 0;
+  for (int k = 0; k < nb_cells && *nb_clues < target && solvable; k++) {
+    int i = cells[k] / size;
+    int j = cells[k] % size;
+    if (bb_get(&work, i, j) != '_') {
+      continue;
+    }
+    char values[2] = {*nb_clues % 2 ? '1' : '0', *nb_clues % 2 ? '0' : '1'};
+    solvable = false;
+    for (int v = 0; v < 2 && !solvable; v++) {
+      int mark = work.trail_len;
+      bb_put(&work, i, j, values[v]);
+      solvable = stabilise_with_heuristics(&work);
+      if (solvable) {
+        bb_put(g, i, j, values[v]);
+        (*nb_clues)++;
+      } else {
+        grid_trail_undo(&work, mark);
+      }
+    }
   }
+  free(cells);
 
-  if (verbose) {
-    printf("Result of the exploration!\n");
-    grid_print(&gridCopy1, stdout);
+  // The working grid holds the clues and what they imply, the clause
+  // learning engine decides quickly whether it has a solution where the
+  // backtracking search can thrash on sparse large grids
+  t_grid solution;
+  solvable = solvable && cdcl_solve(&work, &solution, 0);
+  if (solvable) {
+    grid_free(&solution);
+  } else {
+    grid_free(g);
   }
+  grid_free(&work);
+  return solvable;
+}
 
-  if (is_consistent(&gridCopy1, verbose)) {
-    // if this path leads to a solution, we don't need to do backtracking
-    if (has_solution(&gridCopy1, output, verbose, unique)) {
-      return true;
-    }
-  }
-  // if the firs path  doesn't lead to a solution, we do backtracking
-  if (verbose) {
-    printf("######################################################\n");
-    printf("Inconsitent path, bactracking...!\n");
-    printf("Choice made....\n");
-    grid_choice_print(other_choice, stdout);
-    grid_print(&gridCopy2, stdout);
-  }
+// Banner, number, grid and blank lines of a solution, see grid_solution_print
+#define SOLUTION_TEXT_SIZE(size) (128 + GRID_TEXT_SIZE(size))
 
-  set_cell(other_choice.row, other_choice.column, &gridCopy2, '_');
-  grid_choice_apply(&gridCopy2, other_choice);
-  if (is_consistent(&gridCopy2, 0)) {
-    stabilise_with_heuristics(&gridCopy2);
-  }
+static size_t solution_render(t_grid *grid, int number, char *buffer) {
+  static const char banner[] =
+      "######################################################\n";
+  size_t length = sizeof(banner) - 1;
 
-  return has_solution(&gridCopy2, output, verbose, unique);
+  memcpy(buffer, banner, length);
+  length += sprintf(buffer + length, "Solution n° %d\n", number);
+  length += grid_render(grid, buffer + length);
+  memcpy(buffer + length, "\n\n", 2);
+  return length + 2;
 }
 
-static void grid_constructor(int size, t_grid *g, int N) {
-  srand(time(NULL));
-  // Calculate the number of cells to be filled with '0' and '1'
-  int num_cells = size * size;
-  int num_filled_cells = (N * num_cells) / 100;
+void grid_solution_print(t_grid *grid, int number, FILE *output) {
+  char buffer[SOLUTION_TEXT_SIZE(64)];
+  fwrite(buffer, 1, solution_render(grid, number, buffer), output);
+}
 
-  //  allocate the grid and Initialize it with empty cells
-  grid_allocate(g, size);
-  for (int i = 0; i < num_cells; i++) {
-    g->grid[i] = '_';
-  }
-  // Fill the grid randomly with '0' and check consitency
-  for (int i = 0; i < abs(num_filled_cells / 2); i++) {
-    int line, column;
-    int row, col;
-    do {
-      line = rand() % size;
-      column = rand() % size;
-      while (line == row && column == col) {
-        line = rand() % size;
-        column = rand() % size;
-      }
+void grid_solution_write(t_grid *grid, int number, t_writer *writer) {
+  char *buffer = writer_reserve(writer, SOLUTION_TEXT_SIZE(grid->size));
+  writer_commit(writer, solution_render(grid, number, buffer));
+}
 
-    } while (get_cell(line, column, g) != '_');
+// Enumerate every solution of the grid, which is given back unchanged
+void grid_enumerate(t_grid *grid, int verbose, t_solution_handler handler,
+                    void *data) {
+  bool attached = grid->trail != NULL;
+  int mark = grid->trail_len;
 
-    set_cell(line, column, g, '0');
+  t_search search;
 
-    if (!is_consistent(g, 0)) {
-      set_cell(line, column, g, '_');
-      i--;
-      row = line;
-      col = column;
-    }
+  grid_trail_attach(grid);
+  dfs_init(&search, grid);
+  search.verbose = verbose;
+  while (dfs_next(&search) == 1) {
+    handler(grid, data);
   }
-  // Fill the grid randomly with '1' and check consitency
-  for (int i = 0; i < abs(num_filled_cells / 2); i++) {
-    int line, column;
-    int row, col;
-    do {
-      line = rand() % size;
-      column = rand() % size;
-      while (line == row && column == col) {
-        line = rand() % size;
-        column = rand() % size;
-      }
-    } while (get_cell(line, column, g) != '_');
-
-    set_cell(line, column, g, '1');
-    if (!is_consistent(g, 0)) {
-      set_cell(line, column, g, '_');
-
-      i--;
-      row = line;
-      col = column;
-    }
+  dfs_free(&search);
+  grid_trail_undo(grid, mark);
+  if (!attached) {
+    grid_trail_detach(grid);
   }
 }
 
-// Search and return all solutions if there is
-static bool search_solutions(t_grid *grid, FILE *output, int verbose, int *nb) {
-  // If the grid is valid it means that a solution is found
-  if (is_valid(grid)) {
-    *nb += 1;
-    fprintf(output, "######################################################\n");
-    fprintf(output, "Solution n° %d\n", *nb);
-    grid_print(grid, output);
-    fprintf(output, "\n\n");
-    grid_free(grid);
-    return true;
-  }
-  // if the given grid is inconsistent then return false
-  if (!is_consistent(grid, verbose)) {
-    if (verbose) {
-      printf("Inconsistent grid!, exploring other remaining paths...\n");
-      grid_print(grid, stdout);
-    }
-    grid_free(grid);
-    return false;
-  }
-  // Other make a choice and continue exploring
-  choice_t choice;
-  choice_t other_choice;
-  t_grid gridCopy1;
-  t_grid gridCopy2;
-  grid_copy(grid, &gridCopy1); // gridCopy1 is used to explore one path
-  grid_copy(grid, &gridCopy2); // gridCopy2 is used to explore the remaining
-                               // path
-  choice = grid_choice(&gridCopy1);
-  // If choice.row == -1, it means (according to our implementation) that no
-  // choice will lead to a consistent grid therefore the grid is inconstent
-  if (choice.row == -1) {
-    return false;
-  }
-  // We store the secondChoice to explore remaining paths
-  other_choice = secondChoice(choice);
-  grid_choice_apply(&gridCopy1, choice);
-  // Checking consistency after applying the choice
-  if (is_consistent(&gridCopy1, 0)) {
-    // Apply heuristics to the grid
-    stabilise_with_heuristics(&gridCopy1);
-    if (verbose) {
-      printf("######################################################\n");
-      printf("First choice.... \n");
-      grid_choice_print(choice, stdout);
-      printf("Result of the exploration!\n");
-      grid_print(&gridCopy1, stdout);
-    }
-    search_solutions(&gridCopy1, output, verbose, nb);
-  }
-  // Explore the remaining path as we search all solution
-  set_cell(other_choice.row, other_choice.column, &gridCopy2, '_');
-  grid_choice_apply(&gridCopy2, other_choice);
-  if (is_consistent(&gridCopy2, 0)) {
-    stabilise_with_heuristics(&gridCopy2);
-    if (verbose) {
-      printf("######################################################\n");
-      printf("Second choice.... \n");
-      grid_choice_print(other_choice, stdout);
-      printf("Result of the exploration!\n");
-      grid_print(&gridCopy2, stdout);
-    }
-    search_solutions(&gridCopy2, output, verbose, nb);
+typedef struct {
+  FILE *output;
+  t_writer *writer; // NULL when the solutions go straight to output
+  t_bin_encoder *encoder; // NULL for the text format
+  int nb_solutions;
+} t_solution_printer;
+
+static void print_next_solution(t_grid *grid, void *data) {
+  t_solution_printer *printer = (t_solution_printer *)data;
+  if (printer->encoder != NULL) {
+    bin_encode_solution(printer->encoder, grid);
+    printer->nb_solutions++;
+  } else if (printer->writer != NULL) {
+    grid_solution_write(grid, ++printer->nb_solutions, printer->writer);
+  } else {
+    grid_solution_print(grid, ++printer->nb_solutions, printer->output);
   }
-  // if any path doesn't lead to a solution, the grid is inconsistence
-  return false;
 }
 
-void generate_grid(int size, int N, t_grid *g, FILE *fd, int unique_mode,
+void generate_grid(int size, int N, t_grid *g, int unique_mode, t_rng *rng,
                    int verbose) {
+  double start = stats_clock();
   if (!unique_mode) {
-    grid_constructor(size, g, N);
-    while (!has_solution(g, fd, verbose, 1)) {
-      grid_free(g);
-      grid_constructor(size, g, N);
+    int nb_clues;
+    int attempts = 1;
+    while (!grid_constructor(size, g, N, rng, &nb_clues)) {
+      attempts++;
+    }
+    if (verbose) {
+      printf("Grid generated with %d clues out of %d cells in %d attempt%s\n",
+             nb_clues, size * size, attempts, attempts > 1 ? "s" : "");
     }
   } else {
-    srand(time(NULL));
-    // Calculate the number of cells to be filled with '0' and '1'
-    int num_cells = size * size;
-
-    //  allocate the grid and Initialize it with empty cells
+    //  allocate the grid, every cell is initialised as empty
     grid_allocate(g, size);
-    for (int i = 0; i < num_cells; i++) {
-      g->grid[i] = '_';
-    }
-    generateUniqueSolution(g, verbose);
+    generate_unique_grid(g, N, rng, verbose);
   }
+  // The grid buffers cached during the generation go back to the heap
+  grid_pool_release();
+  stats_time(PHASE_GENERATION, start);
+  if (verbose) {
+    grid_pool_print_stats(stdout);
+  }
+}
 
-  // if mode unique activated search for a grid having at least one solution
+void grid_solutions_summary(int nb_solutions, FILE *output) {
+  fprintf(output, "######################################################\n");
+  fprintf(output, "Number of solutions found %d\n", nb_solutions);
+  fprintf(output, "######################################################\n");
 }
 
-t_grid *grid_solver(t_grid *grid, const t_mode mode, FILE *output,
-                    int verbose) {
+// The search works in place on the grid, which is given back unchanged
+t_grid *grid_solver(t_grid *grid, const t_mode mode, const t_engine engine,
+                    FILE *output, const t_format format,
+                    bool background_output, int verbose) {
+
+  if (mode == MODE_FIRST && engine == ENGINE_CDCL) {
+    t_grid solution;
+    if (cdcl_solve(grid, &solution, verbose)) {
+      grid_first_solution_print(&solution, output);
+      grid_free(&solution);
+    }
+    grid_pool_release();
+    return grid;
+  }
 
+  grid_trail_attach(grid);
   if (mode == MODE_FIRST) {
-    int unique_mode = 0;
-    has_solution(grid, output, verbose, unique_mode);
+    if (has_solution(grid, verbose)) {
+      grid_first_solution_print(grid, output);
+    }
+  } else if (mode == MODE_ALL && format == FORMAT_BIN) {
+    // The output only holds the binary stream, the verbose traces still go
+    // to stdout
+    t_bin_encoder encoder;
+    t_solution_printer printer = {output, NULL, &encoder, 0};
+    t_writer *writer = writer_open(output, background_output);
+    bin_encoder_init(&encoder, writer, grid->size);
+    grid_enumerate(grid, verbose, print_next_solution, &printer);
+    writer_close(writer);
   } else if (mode == MODE_ALL) {
-    int nb_solutions = 0;
+    // The verbose traces go to stdout, the solutions are not buffered then
+    // to keep them in order with the traces
+    t_solution_printer printer = {output, NULL, NULL, 0};
     fprintf(output, "Searching for all solutions...\n");
-    search_solutions(grid, output, verbose, &nb_solutions);
-    fprintf(output, "######################################################\n");
-    fprintf(output, "Number of solutions found %d\n", nb_solutions);
-    fprintf(output, "######################################################\n");
+    if (!verbose) {
+      fflush(output);
+      printer.writer = writer_open(output, background_output);
+    }
+    grid_enumerate(grid, verbose, print_next_solution, &printer);
+    if (printer.writer != NULL) {
+      writer_close(printer.writer);
+    }
+    grid_solutions_summary(printer.nb_solutions, output);
+  }
+  grid_trail_undo(grid, 0);
+  grid_trail_detach(grid);
+  grid_pool_release();
+  if (verbose) {
+    grid_pool_print_stats(stdout);
   }
   return grid;
 }
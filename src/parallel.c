@@ -0,0 +1,404 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/parallel.h"
+#include "../include/bitboard.h"
+#include "../include/pattern.h"
+#include "../include/search.h"
+#include "../include/stats.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parallel enumeration of all the solutions (MODE_ALL).
+//
+// The choice tree is cut into tasks: a task owns a copy of the grid at one
+// node of the tree. Above the split depth a task makes a choice and pushes
+// one task per branch, below it the task enumerates its whole subtree with
+// grid_enumerate. Each worker has a deque of tasks: the owner pushes and pops
+// at the bottom (depth first), an idle worker steals the oldest task at the
+// top of another deque, which is the root of the largest unexplored subtree.
+// A worker which finds no task sleeps until a task is pushed or the last task
+// is finished, so that idle workers do not take cores from the busy ones.
+//
+// Without ordering, the solutions are printed as soon as they are found. In
+// ordered mode each task is a node of the tree; the solutions of a leaf task
+// are kept in its node and the calling thread prints the nodes in depth first
+// order, giving the same output as the sequential search.
+
+typedef enum { NODE_PENDING, NODE_SPLIT, NODE_LEAF } t_node_state;
+
+typedef struct t_node {
+  t_node_state state;      // Written under the output lock
+  struct t_node *child[2]; // Set when the node is split
+  uint64_t *solutions;     // Rows of each solution found under a leaf
+  int nb_solutions;
+  int capacity;
+} t_node;
+
+typedef struct {
+  t_grid grid;
+  int depth;
+  t_node *node; // NULL when the output is not ordered
+} t_task;
+
+typedef struct {
+  pthread_mutex_t lock;
+  t_task *tasks; // Tasks of the deque are tasks[top .. bottom - 1]
+  int top;
+  int bottom;
+  int capacity;
+} t_deque;
+
+typedef struct {
+  int jobs;
+  int split_depth;
+  bool ordered;
+  FILE *output;
+  t_deque *deques;
+  atomic_long outstanding; // Tasks pushed and not finished yet
+  atomic_long pushes;      // Tasks pushed since the start
+  atomic_int idle;         // Workers waiting for a task
+  pthread_mutex_t idle_lock;
+  pthread_cond_t work; // Signaled when a task is pushed or the work is done
+  atomic_int nb_solutions;
+  pthread_mutex_t output_lock;
+  pthread_cond_t node_done; // Signaled when a node leaves NODE_PENDING
+} t_scheduler;
+
+typedef struct {
+  t_scheduler *scheduler;
+  int id;
+} t_worker;
+
+static void *xmalloc(size_t size) {
+  void *p = malloc(size);
+  if (p == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the scheduler.\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+static t_node *node_new(void) {
+  t_node *node = (t_node *)xmalloc(sizeof(t_node));
+  node->state = NODE_PENDING;
+  node->child[0] = NULL;
+  node->child[1] = NULL;
+  node->solutions = NULL;
+  node->nb_solutions = 0;
+  node->capacity = 0;
+  return node;
+}
+
+static void deque_push(t_deque *deque, t_task *task) {
+  pthread_mutex_lock(&deque->lock);
+  if (deque->top == deque->bottom) {
+    deque->top = 0;
+    deque->bottom = 0;
+  }
+  if (deque->bottom == deque->capacity) {
+    deque->capacity = deque->capacity == 0 ? 64 : 2 * deque->capacity;
+    deque->tasks = (t_task *)realloc(deque->tasks,
+                                     deque->capacity * sizeof(t_task));
+    if (deque->tasks == NULL) {
+      fprintf(stderr, "Error: Memory allocation failed for the scheduler.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  deque->tasks[deque->bottom++] = *task;
+  pthread_mutex_unlock(&deque->lock);
+}
+
+// Take a task at the bottom (owner) or at the top (thief) of a deque
+static bool deque_take(t_deque *deque, t_task *task, bool steal) {
+  bool found = false;
+  pthread_mutex_lock(&deque->lock);
+  if (deque->top < deque->bottom) {
+    *task = steal ? deque->tasks[deque->top++] : deque->tasks[--deque->bottom];
+    found = true;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+static void push_task(t_scheduler *scheduler, int id, t_grid *grid, int depth,
+                      t_node *node) {
+  t_task task = {*grid, depth, node};
+  atomic_fetch_add(&scheduler->outstanding, 1);
+  deque_push(&scheduler->deques[id], &task);
+  // A worker counts itself idle before it checks pushes, so either it sees
+  // this push or it is seen here and woken up
+  atomic_fetch_add(&scheduler->pushes, 1);
+  if (atomic_load(&scheduler->idle) > 0) {
+    pthread_mutex_lock(&scheduler->idle_lock);
+    pthread_cond_signal(&scheduler->work);
+    pthread_mutex_unlock(&scheduler->idle_lock);
+  }
+}
+
+// Sleep until a task is pushed after the pushes seen, or all the tasks are
+// finished
+static void wait_for_task(t_scheduler *scheduler, long seen) {
+  pthread_mutex_lock(&scheduler->idle_lock);
+  atomic_fetch_add(&scheduler->idle, 1);
+  while (atomic_load(&scheduler->pushes) == seen &&
+         atomic_load(&scheduler->outstanding) > 0) {
+    pthread_cond_wait(&scheduler->work, &scheduler->idle_lock);
+  }
+  atomic_fetch_sub(&scheduler->idle, 1);
+  pthread_mutex_unlock(&scheduler->idle_lock);
+}
+
+static void node_finish(t_scheduler *scheduler, t_node *node,
+                        t_node_state state) {
+  if (node == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&scheduler->output_lock);
+  node->state = state;
+  pthread_cond_broadcast(&scheduler->node_done);
+  pthread_mutex_unlock(&scheduler->output_lock);
+}
+
+typedef struct {
+  t_scheduler *scheduler;
+  t_node *node;
+} t_task_output;
+
+static void print_solution(t_grid *grid, void *data) {
+  t_scheduler *scheduler = ((t_task_output *)data)->scheduler;
+
+  pthread_mutex_lock(&scheduler->output_lock);
+  int number = atomic_fetch_add(&scheduler->nb_solutions, 1) + 1;
+  grid_solution_print(grid, number, scheduler->output);
+  pthread_mutex_unlock(&scheduler->output_lock);
+}
+
+// Ordered mode: the rows of the solution are kept in the node of the task
+static void store_solution(t_grid *grid, void *data) {
+  t_node *node = ((t_task_output *)data)->node;
+
+  if (node->nb_solutions == node->capacity) {
+    node->capacity = node->capacity == 0 ? 16 : 2 * node->capacity;
+    node->solutions = (uint64_t *)realloc(
+        node->solutions, node->capacity * grid->size * sizeof(uint64_t));
+    if (node->solutions == NULL) {
+      fprintf(stderr, "Error: Memory allocation failed for the solutions.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  memcpy(node->solutions + node->nb_solutions * grid->size, grid->row_ones,
+         grid->size * sizeof(uint64_t));
+  node->nb_solutions++;
+}
+
+// Split the node of the task in two tasks, one per value of the choice.
+// Returns false when the task has to be explored as a whole.
+static bool split_task(t_scheduler *scheduler, int id, t_task *task) {
+  t_grid *grid = &task->grid;
+
+  if (task->depth >= scheduler->split_depth ||
+      grid->empty_cells <= 2 * grid->size || !is_consistent(grid, 0)) {
+    return false;
+  }
+  choice_t choice = grid_choice(grid);
+  if (choice.row == -1) {
+    return false;
+  }
+  stats_choice();
+  stats_depth(task->depth + 1);
+
+  char values[2] = {choice.choice, choice.choice == '0' ? '1' : '0'};
+  t_grid children[2];
+  bool feasible[2];
+  for (int b = 0; b < 2; b++) {
+    grid_copy(grid, &children[b]);
+    set_cell(choice.row, choice.column, &children[b], values[b]);
+    stats_node();
+    feasible[b] = is_consistent(&children[b], 0) &&
+                  stabilise_with_heuristics(&children[b]);
+    if (task->node != NULL) {
+      task->node->child[b] = node_new();
+    }
+  }
+  // The second branch is pushed first so that the owner goes on with the
+  // first one while thieves take the second one
+  for (int b = 1; b >= 0; b--) {
+    t_node *child = task->node != NULL ? task->node->child[b] : NULL;
+    if (feasible[b]) {
+      push_task(scheduler, id, &children[b], task->depth + 1, child);
+    } else {
+      grid_free(&children[b]);
+      node_finish(scheduler, child, NODE_LEAF);
+    }
+  }
+  node_finish(scheduler, task->node, NODE_SPLIT);
+  return true;
+}
+
+static void run_task(t_scheduler *scheduler, int id, t_task *task) {
+  if (!split_task(scheduler, id, task)) {
+    t_task_output output = {scheduler, task->node};
+    grid_enumerate(&task->grid, 0,
+                   task->node != NULL ? store_solution : print_solution,
+                   &output);
+    node_finish(scheduler, task->node, NODE_LEAF);
+  }
+  grid_free(&task->grid);
+}
+
+static void *worker_main(void *arg) {
+  t_worker *worker = (t_worker *)arg;
+  t_scheduler *scheduler = worker->scheduler;
+  t_task task;
+
+  while (atomic_load(&scheduler->outstanding) > 0) {
+    long seen = atomic_load(&scheduler->pushes);
+    bool found = deque_take(&scheduler->deques[worker->id], &task, false);
+    for (int k = 1; !found && k < scheduler->jobs; k++) {
+      int victim = (worker->id + k) % scheduler->jobs;
+      found = deque_take(&scheduler->deques[victim], &task, true);
+    }
+    if (found) {
+      run_task(scheduler, worker->id, &task);
+      if (atomic_fetch_sub(&scheduler->outstanding, 1) == 1) {
+        // Last task: the sleeping workers are woken up to leave
+        pthread_mutex_lock(&scheduler->idle_lock);
+        pthread_cond_broadcast(&scheduler->work);
+        pthread_mutex_unlock(&scheduler->idle_lock);
+      }
+    } else {
+      wait_for_task(scheduler, seen);
+    }
+  }
+  // The grid buffers cached by this thread go back to the heap
+  grid_pool_release();
+  stats_flush();
+  return NULL;
+}
+
+// Print the solutions of the tree in depth first order, waiting for the
+// nodes which are not explored yet
+static void write_ordered(t_scheduler *scheduler, t_node *root, int size) {
+  int capacity = 64;
+  int len = 0;
+  t_node **stack = (t_node **)xmalloc(capacity * sizeof(t_node *));
+  t_grid grid;
+  uint64_t filled[64];
+
+  grid_allocate(&grid, size);
+  for (int i = 0; i < size; i++) {
+    filled[i] = bb_line_mask(size);
+  }
+  stack[len++] = root;
+  while (len > 0) {
+    t_node *node = stack[--len];
+
+    pthread_mutex_lock(&scheduler->output_lock);
+    while (node->state == NODE_PENDING) {
+      pthread_cond_wait(&scheduler->node_done, &scheduler->output_lock);
+    }
+    pthread_mutex_unlock(&scheduler->output_lock);
+
+    if (node->state == NODE_SPLIT) {
+      if (len + 2 > capacity) {
+        capacity *= 2;
+        stack = (t_node **)realloc(stack, capacity * sizeof(t_node *));
+        if (stack == NULL) {
+          fprintf(stderr, "Error: Memory allocation failed for the writer.\n");
+          exit(EXIT_FAILURE);
+        }
+      }
+      stack[len++] = node->child[1];
+      stack[len++] = node->child[0];
+    }
+    for (int s = 0; s < node->nb_solutions; s++) {
+      bb_load(&grid, node->solutions + s * size, filled);
+      int number = atomic_fetch_add(&scheduler->nb_solutions, 1) + 1;
+      grid_solution_print(&grid, number, scheduler->output);
+    }
+    free(node->solutions);
+    free(node);
+  }
+  grid_free(&grid);
+  free(stack);
+}
+
+// Enumerate all the solutions of the grid with jobs worker threads. When
+// ordered is set the solutions are printed in the order of the sequential
+// search, otherwise in the order they are found.
+void grid_solver_parallel(t_grid *grid, FILE *output, int jobs, bool ordered) {
+  t_scheduler scheduler;
+  int log_jobs = 0;
+
+  while ((1 << log_jobs) < jobs) {
+    log_jobs++;
+  }
+  scheduler.jobs = jobs;
+  // Enough tasks to keep every worker busy, while keeping them large enough
+  // to pay for the copy of the grid
+  scheduler.split_depth = 4 + 2 * log_jobs;
+  scheduler.ordered = ordered;
+  scheduler.output = output;
+  scheduler.deques = (t_deque *)xmalloc(jobs * sizeof(t_deque));
+  for (int w = 0; w < jobs; w++) {
+    pthread_mutex_init(&scheduler.deques[w].lock, NULL);
+    scheduler.deques[w].tasks = NULL;
+    scheduler.deques[w].top = 0;
+    scheduler.deques[w].bottom = 0;
+    scheduler.deques[w].capacity = 0;
+  }
+  atomic_init(&scheduler.outstanding, 0);
+  atomic_init(&scheduler.pushes, 0);
+  atomic_init(&scheduler.idle, 0);
+  pthread_mutex_init(&scheduler.idle_lock, NULL);
+  pthread_cond_init(&scheduler.work, NULL);
+  atomic_init(&scheduler.nb_solutions, 0);
+  pthread_mutex_init(&scheduler.output_lock, NULL);
+  pthread_cond_init(&scheduler.node_done, NULL);
+
+  // Tables shared by the workers are built before they start
+  line_patterns(grid->size);
+
+  fprintf(output, "Searching for all solutions...\n");
+  t_node *root = ordered ? node_new() : NULL;
+  t_grid root_grid;
+  grid_copy(grid, &root_grid);
+  push_task(&scheduler, 0, &root_grid, 0, root);
+
+  pthread_t *threads = (pthread_t *)xmalloc(jobs * sizeof(pthread_t));
+  t_worker *workers = (t_worker *)xmalloc(jobs * sizeof(t_worker));
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, SEARCH_THREAD_STACK_SIZE);
+  for (int w = 0; w < jobs; w++) {
+    workers[w].scheduler = &scheduler;
+    workers[w].id = w;
+    if (pthread_create(&threads[w], &attr, worker_main, &workers[w]) != 0) {
+      fprintf(stderr, "Error: cannot create a worker thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  pthread_attr_destroy(&attr);
+  if (ordered) {
+    write_ordered(&scheduler, root, grid->size);
+  }
+  for (int w = 0; w < jobs; w++) {
+    pthread_join(threads[w], NULL);
+  }
+
+  grid_solutions_summary(atomic_load(&scheduler.nb_solutions), output);
+
+  for (int w = 0; w < jobs; w++) {
+    pthread_mutex_destroy(&scheduler.deques[w].lock);
+    free(scheduler.deques[w].tasks);
+  }
+  pthread_mutex_destroy(&scheduler.idle_lock);
+  pthread_cond_destroy(&scheduler.work);
+  pthread_mutex_destroy(&scheduler.output_lock);
+  pthread_cond_destroy(&scheduler.node_done);
+  free(scheduler.deques);
+  free(threads);
+  free(workers);
+  grid_pool_release();
+}
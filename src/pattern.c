@@ -0,0 +1,167 @@
+#include "../include/pattern.h"
+#include "../include/bitboard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if BB_X86
+#include <immintrin.h>
+#endif
+
+#define PATTERN_MAX_SIZE 16
+
+// One table per size 4, 8 and 16, built the first time it is asked for
+static t_line_patterns tables[3];
+
+static void line_patterns_build(t_line_patterns *table, int size) {
+  uint64_t full = bb_line_mask(size);
+  int capacity = 0;
+
+  table->size = size;
+  table->count = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    // The first pass counts the valid lines, the second one stores them
+    if (pass == 1) {
+      table->lines = (uint64_t *)malloc(capacity * sizeof(uint64_t));
+      if (table->lines == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the patterns.\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    for (uint64_t x = 0; x <= full; x++) {
+      if (bb_line_ok(x, full, size) && bb_popcount(x) == size / 2) {
+        if (pass == 0) {
+          capacity++;
+        } else {
+          table->lines[table->count++] = x;
+        }
+      }
+    }
+  }
+}
+
+// Return the table of the valid lines of a size, NULL for sizes 32 and 64
+const t_line_patterns *line_patterns(int size) {
+  if (size != 4 && size != 8 && size != PATTERN_MAX_SIZE) {
+    return NULL;
+  }
+  t_line_patterns *table = &tables[__builtin_ctz(size) - 2];
+  if (table->lines == NULL) {
+    line_patterns_build(table, size);
+  }
+  return table;
+}
+
+// Number of the full lines of the set (see bb_line_set_add) which agree with
+// the filled cells of a line, their ones masks are stored in used
+static int used_lines(const uint64_t *full_lines, int size, uint64_t ones,
+                      uint64_t filled, uint64_t *used) {
+  int slots = 2 * size;
+  const uint64_t *counts = full_lines + slots;
+  int nb_used = 0;
+
+  for (int s = 0; s < slots; s++) {
+    if (counts[s] != 0 && (full_lines[s] & filled) == ones) {
+      used[nb_used++] = full_lines[s];
+    }
+  }
+  return nb_used;
+}
+
+// Fold the valid lines first to last into all_ones and any_ones
+static bool infer_scalar(const t_line_patterns *patterns, int first, int last,
+                         uint64_t ones, uint64_t filled, const uint64_t *used,
+                         int nb_used, uint64_t *all_ones, uint64_t *any_ones) {
+  bool found = false;
+
+  for (int k = first; k < last; k++) {
+    uint64_t line = patterns->lines[k];
+    if ((line & filled) != ones) {
+      continue;
+    }
+    bool is_used = false;
+    for (int u = 0; u < nb_used && !is_used; u++) {
+      is_used = line == used[u];
+    }
+    if (is_used) {
+      continue;
+    }
+    *all_ones &= line;
+    *any_ones |= line;
+    found = true;
+  }
+  return found;
+}
+
+#if BB_X86
+// Four valid lines at a time, count is a multiple of 4
+BB_AVX2 static bool infer_avx2(const t_line_patterns *patterns, int count,
+                               uint64_t ones, uint64_t filled,
+                               const uint64_t *used, int nb_used,
+                               uint64_t *all_ones, uint64_t *any_ones) {
+  const __m256i vones = _mm256_set1_epi64x(ones);
+  const __m256i vfilled = _mm256_set1_epi64x(filled);
+  const __m256i full = _mm256_set1_epi64x(-1);
+  __m256i all = full;
+  __m256i any = _mm256_setzero_si256();
+  __m256i found = _mm256_setzero_si256();
+
+  for (int k = 0; k < count; k += 4) {
+    __m256i line = _mm256_loadu_si256((const __m256i *)(patterns->lines + k));
+    __m256i kept =
+        _mm256_cmpeq_epi64(_mm256_and_si256(line, vfilled), vones);
+    for (int u = 0; u < nb_used; u++) {
+      kept = _mm256_andnot_si256(
+          _mm256_cmpeq_epi64(line, _mm256_set1_epi64x(used[u])), kept);
+    }
+    all = _mm256_and_si256(all, _mm256_blendv_epi8(full, line, kept));
+    any = _mm256_or_si256(any, _mm256_and_si256(line, kept));
+    found = _mm256_or_si256(found, kept);
+  }
+
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i *)lanes, all);
+  *all_ones &= lanes[0] & lanes[1] & lanes[2] & lanes[3];
+  _mm256_storeu_si256((__m256i *)lanes, any);
+  *any_ones |= lanes[0] | lanes[1] | lanes[2] | lanes[3];
+  return !_mm256_testz_si256(found, found);
+}
+#endif
+
+// Keep the valid lines which agree with the filled cells of a line and which
+// are not already used by a full line (full_lines is the hash set of the full
+// lines of the same direction, see bb_line_set_add). The empty cells having
+// the same value in every kept line are returned in forced_ones and
+// forced_zeros. Returns false when no valid line is kept: the line cannot be
+// completed.
+bool line_patterns_infer(const t_line_patterns *patterns, uint64_t ones,
+                         uint64_t filled, const uint64_t *full_lines,
+                         uint64_t *forced_ones, uint64_t *forced_zeros) {
+  uint64_t all_ones = ~0ULL; // cells set in every kept line
+  uint64_t any_ones = 0;     // cells set in at least one kept line
+  bool found = false;
+  uint64_t used[PATTERN_MAX_SIZE];
+  int nb_used = 0;
+  int k = 0;
+
+  // The few full lines which the line could repeat are looked for in each
+  // valid line, rather than each valid line in the set
+  if (full_lines != NULL) {
+    nb_used = used_lines(full_lines, patterns->size, ones, filled, used);
+  }
+#if BB_X86
+  if (bb_has_avx2()) {
+    k = patterns->count & ~3;
+    found = infer_avx2(patterns, k, ones, filled, used, nb_used, &all_ones,
+                       &any_ones);
+  }
+#endif
+  found |= infer_scalar(patterns, k, patterns->count, ones, filled, used,
+                        nb_used, &all_ones, &any_ones);
+
+  if (!found) {
+    return false;
+  }
+  uint64_t empty = bb_line_mask(patterns->size) & ~filled;
+  *forced_ones = all_ones & empty;
+  *forced_zeros = ~any_ones & empty;
+  return true;
+}
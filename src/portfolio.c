@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/portfolio.h"
+#include "../include/bitboard.h"
+#include "../include/pattern.h"
+#include "../include/search.h"
+#include "../include/stats.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Portfolio search of a first solution (MODE_FIRST).
+//
+// Several differently configured searches race on their own copy of the grid,
+// one per thread. The first one to finish, with a solution or with the proof
+// that there is none, raises the stop flag, which every other search checks
+// at each node. The configurations differ in
+// the order of the cells, the order of the values, the propagation and the
+// random seed, so that a grid which is hard for one of them is unlikely to be
+// hard for all of them.
+
+static const t_portfolio_config portfolio_configs[] = {
+    {CELL_MOST_CONSTRAINED, VALUE_DEMAND, true},
+    {CELL_COLUMN_MAJOR, VALUE_ONE_FIRST, true},
+    {CELL_RANDOM, VALUE_RANDOM, true},
+    {CELL_ROW_MAJOR, VALUE_RANDOM, true},
+    {CELL_COLUMN_MAJOR, VALUE_RANDOM, true},
+    {CELL_RANDOM, VALUE_ZERO_FIRST, false},
+    {CELL_ROW_MAJOR, VALUE_ONE_FIRST, false},
+    {CELL_MOST_CONSTRAINED, VALUE_RANDOM, true},
+    {CELL_ROW_MAJOR, VALUE_ZERO_FIRST, true},
+};
+
+#define NB_PORTFOLIO_CONFIGS                                                   \
+  ((int)(sizeof(portfolio_configs) / sizeof(portfolio_configs[0])))
+
+typedef struct {
+  const t_portfolio_config *config;
+  t_rng rng;         // Random generator of the search
+  atomic_bool *stop; // Raised when any search of the portfolio is over
+} t_strategy;
+
+typedef struct {
+  t_grid grid;
+  t_strategy strategy;
+  atomic_int *winner; // Index of the first search which finished
+  int id;
+  bool solved; // The search finished with a solution
+  pthread_t thread;
+} t_racer;
+
+// First empty cell in the order of the configuration, row is -1 when the
+// grid is full
+static choice_t pick_cell(t_grid *grid, t_strategy *s) {
+  choice_t choice = {-1, -1, '_'};
+  uint64_t full = bb_line_mask(grid->size);
+  int n = grid->size;
+
+  switch (s->config->cell_order) {
+  case CELL_MOST_CONSTRAINED:
+    choice = grid_choice_cell(grid);
+    break;
+  case CELL_ROW_MAJOR:
+    for (int i = 0; i < n; i++) {
+      if (grid->row_filled[i] != full) {
+        choice.row = i;
+        choice.column = __builtin_ctzll(~grid->row_filled[i]);
+        break;
+      }
+    }
+    break;
+  case CELL_COLUMN_MAJOR:
+    for (int j = 0; j < n; j++) {
+      if (grid->col_filled[j] != full) {
+        choice.row = __builtin_ctzll(~grid->col_filled[j]);
+        choice.column = j;
+        break;
+      }
+    }
+    break;
+  case CELL_RANDOM: {
+    // Scan the cells from a random one
+    int start = (int)rng_below(&s->rng, n * n);
+    for (int k = 0; k < n * n; k++) {
+      int index = (start + k) % (n * n);
+      if (bb_get(grid, index / n, index % n) == '_') {
+        choice.row = index / n;
+        choice.column = index % n;
+        break;
+      }
+    }
+    break;
+  }
+  }
+  return choice;
+}
+
+// Choose a cell and the value to try first. Like grid_choice, row is -1 when
+// the chosen cell accepts no value.
+static choice_t portfolio_choice(t_grid *grid, void *data) {
+  t_strategy *s = (t_strategy *)data;
+  choice_t choice = pick_cell(grid, s);
+  if (choice.row == -1) {
+    return choice;
+  }
+
+  char first = '0';
+  if (s->config->value_order == VALUE_DEMAND) {
+    first = grid_choice_value(grid, choice.row, choice.column);
+  } else if (s->config->value_order == VALUE_ONE_FIRST ||
+      (s->config->value_order == VALUE_RANDOM && rng_bool(&s->rng))) {
+    first = '1';
+  }
+  char values[2] = {first, first == '0' ? '1' : '0'};
+
+  // Probes are not recorded on the trail
+  int *trail = grid->trail;
+  grid->trail = NULL;
+  for (int v = 0; v < 2 && choice.choice == '_'; v++) {
+    bb_put(grid, choice.row, choice.column, values[v]);
+    if (is_consistent(grid, 0)) {
+      choice.choice = values[v];
+    }
+  }
+  bb_put(grid, choice.row, choice.column, '_');
+  grid->trail = trail;
+
+  if (choice.choice == '_') {
+    choice.row = -1;
+  }
+  return choice;
+}
+
+static void *racer_main(void *arg) {
+  t_racer *racer = (t_racer *)arg;
+
+  t_search search;
+
+  grid_trail_attach(&racer->grid);
+  dfs_init(&search, &racer->grid);
+  search.choose = portfolio_choice;
+  search.data = &racer->strategy;
+  search.propagate = racer->strategy.config->propagate;
+  search.stop = racer->strategy.stop;
+  int result = dfs_next(&search);
+  racer->solved = result == 1;
+  // A finished search answers for the whole portfolio, solution or not: only
+  // the first one is kept and the others are stopped. A search which gave up
+  // leaves the others running.
+  if (result != -1) {
+    int none = -1;
+    if (atomic_compare_exchange_strong(racer->winner, &none, racer->id)) {
+      atomic_store(racer->strategy.stop, true);
+    }
+  }
+  dfs_free(&search);
+  stats_flush();
+  return NULL;
+}
+
+// Race jobs searches for a first solution of the grid and print the first
+// solution found. Returns false when the grid has no solution.
+bool grid_solver_portfolio(t_grid *grid, FILE *output, int jobs) {
+  atomic_bool stop;
+  atomic_int winner;
+  atomic_init(&stop, false);
+  atomic_init(&winner, -1);
+
+  // Tables shared by the searches are built before they start
+  line_patterns(grid->size);
+
+  t_racer *racers = (t_racer *)malloc(jobs * sizeof(t_racer));
+  if (racers == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the portfolio.\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, SEARCH_THREAD_STACK_SIZE);
+  for (int k = 0; k < jobs; k++) {
+    t_racer *racer = &racers[k];
+    grid_copy(grid, &racer->grid);
+    racer->strategy.config = &portfolio_configs[k % NB_PORTFOLIO_CONFIGS];
+    // Searches sharing a configuration differ by their seed
+    rng_seed(&racer->strategy.rng, (uint64_t)k);
+    racer->strategy.stop = &stop;
+    racer->winner = &winner;
+    racer->id = k;
+    racer->solved = false;
+    if (pthread_create(&racer->thread, &attr, racer_main, racer) != 0) {
+      fprintf(stderr, "Error: cannot create a search thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  pthread_attr_destroy(&attr);
+  for (int k = 0; k < jobs; k++) {
+    pthread_join(racers[k].thread, NULL);
+  }
+
+  int first = atomic_load(&winner);
+  bool solved = first >= 0 && racers[first].solved;
+  if (solved) {
+    grid_first_solution_print(&racers[first].grid, output);
+  }
+  for (int k = 0; k < jobs; k++) {
+    grid_free(&racers[k].grid);
+  }
+  free(racers);
+  grid_pool_release();
+  return solved;
+}
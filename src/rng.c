@@ -0,0 +1,29 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/rng.h"
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t splitmix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void rng_seed(t_rng *rng, uint64_t seed) {
+  for (int k = 0; k < 4; k++) {
+    rng->s[k] = splitmix64(&seed);
+  }
+}
+
+uint64_t rng_fresh_seed(void) {
+  static atomic_uint_fast64_t counter;
+  struct timespec t;
+  clock_gettime(CLOCK_REALTIME, &t);
+
+  uint64_t x = (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+  x ^= (uint64_t)getpid() << 32;
+  x += atomic_fetch_add(&counter, 1) * 0xD1B54A32D192ED03ULL;
+  return splitmix64(&x);
+}
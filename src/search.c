@@ -0,0 +1,143 @@
+#include "../include/search.h"
+#include "../include/stats.h"
+#include <stdlib.h>
+
+void dfs_init(t_search *s, t_grid *grid) {
+  s->grid = grid;
+  // Each choice fills at least one empty cell
+  s->capacity = grid->empty_cells + 1;
+  s->stack = (t_search_frame *)malloc(s->capacity * sizeof(t_search_frame));
+  if (s->stack == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the search.\n");
+    exit(EXIT_FAILURE);
+  }
+  s->depth = 0;
+  s->started = false;
+  s->choose = NULL;
+  s->data = NULL;
+  s->propagate = true;
+  s->budget = -1;
+  s->stop = NULL;
+  s->verbose = 0;
+}
+
+void dfs_free(t_search *s) {
+  free(s->stack);
+  s->stack = NULL;
+  s->depth = 0;
+}
+
+static choice_t other_value(choice_t choice) {
+  choice.choice = choice.choice == '0' ? '1' : '0';
+  return choice;
+}
+
+// Apply the value of a choice, returns false when the grid is proven to have
+// no solution
+static bool apply_choice(t_search *s, choice_t choice) {
+  t_grid *grid = s->grid;
+  grid_choice_apply(grid, choice);
+  bool feasible = is_consistent(grid, 0) &&
+                  (!s->propagate || stabilise_with_heuristics(grid));
+  if (s->verbose) {
+    printf("Result of the exploration!\n");
+    grid_print(grid, stdout);
+  }
+  return feasible;
+}
+
+// Examine the node of the top of the stack: 1 when the grid is a solution, 0
+// when it is a dead end, 2 when a choice was pushed and its first value leads
+// to a node to examine, 3 when that value already fails, -1 when the search
+// gives up
+static int expand(t_search *s) {
+  t_grid *grid = s->grid;
+
+  stats_depth(s->depth);
+  if (s->stop != NULL && atomic_load_explicit(s->stop, memory_order_relaxed)) {
+    return -1;
+  }
+  if (is_valid(grid)) {
+    return 1;
+  }
+  if (!is_consistent(grid, s->verbose)) {
+    if (s->verbose) {
+      printf("Inconsistent grid!, exploring other remaining paths...\n");
+      grid_print(grid, stdout);
+    }
+    return 0;
+  }
+
+  choice_t choice = s->choose != NULL ? s->choose(grid, s->data)
+                                      : grid_choice(grid);
+  if (choice.row == -1) {
+    return 0;
+  }
+  if (s->budget == 0) {
+    return -1;
+  }
+  if (s->budget > 0) {
+    s->budget--;
+  }
+  stats_choice();
+
+  t_search_frame *frame = &s->stack[s->depth++];
+  frame->choice = choice;
+  frame->mark = grid->trail_len;
+  frame->second = false;
+  if (s->verbose) {
+    printf("######################################################\n");
+    printf("Choice made....\n");
+    grid_choice_print(choice, stdout);
+  }
+  return apply_choice(s, choice) ? 2 : 3;
+}
+
+int dfs_next(t_search *s) {
+  // A new search starts by examining the grid, a search which stopped at a
+  // solution goes on by backtracking from it
+  bool descend = !s->started;
+  s->started = true;
+
+  for (;;) {
+    if (descend) {
+      int result = expand(s);
+      if (result == 1) {
+        return 1;
+      }
+      if (result == -1) {
+        break;
+      }
+      descend = result == 2;
+      continue;
+    }
+
+    // Backtrack: only the cells filled since the choice are emptied
+    if (s->depth == 0) {
+      return 0;
+    }
+    t_search_frame *frame = &s->stack[s->depth - 1];
+    grid_trail_undo(s->grid, frame->mark);
+    if (frame->second) {
+      s->depth--;
+      continue;
+    }
+    frame->second = true;
+    frame->choice = other_value(frame->choice);
+    stats_backtrack();
+    if (s->verbose) {
+      printf("######################################################\n");
+      printf("Inconsitent path, bactracking...!\n");
+      printf("Choice made....\n");
+      grid_choice_print(frame->choice, stdout);
+    }
+    descend = apply_choice(s, frame->choice);
+  }
+
+  // Give up: the grid goes back to its state before the first choice
+  if (s->depth > 0) {
+    grid_trail_undo(s->grid, s->stack[0].mark);
+    s->depth = 0;
+  }
+  return -1;
+}
@@ -0,0 +1,115 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/stats.h"
+#include <pthread.h>
+#include <time.h>
+
+bool stats_enabled = false;
+_Thread_local t_stats thread_stats;
+
+static t_stats total_stats;
+static pthread_mutex_t total_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *rule_names[NB_RULES] = {"pair", "gap", "half", "table",
+                                           "cdcl"};
+static const char *phase_names[NB_PHASES] = {"parse", "search", "propagation",
+                                             "generation", "output"};
+
+double stats_clock(void) {
+  if (!stats_enabled) {
+    return 0;
+  }
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+void stats_time(t_phase phase, double start) {
+  if (start != 0) {
+    thread_stats.time[phase] += stats_clock() - start;
+  }
+}
+
+void stats_flush(void) {
+  t_stats *s = &thread_stats;
+
+  pthread_mutex_lock(&total_lock);
+  total_stats.nodes += s->nodes;
+  total_stats.choices += s->choices;
+  total_stats.backtracks += s->backtracks;
+  total_stats.conflicts += s->conflicts;
+  total_stats.checks += s->checks;
+  for (int r = 0; r < NB_RULES; r++) {
+    total_stats.propagated[r] += s->propagated[r];
+  }
+  total_stats.grid_allocs += s->grid_allocs;
+  total_stats.heap_allocs += s->heap_allocs;
+  if (s->max_depth > total_stats.max_depth) {
+    total_stats.max_depth = s->max_depth;
+  }
+  for (int p = 0; p < NB_PHASES; p++) {
+    total_stats.time[p] += s->time[p];
+  }
+  pthread_mutex_unlock(&total_lock);
+  *s = (t_stats){0};
+}
+
+static void print_text(FILE *output, const t_stats *s) {
+  uint64_t propagated = 0;
+  for (int r = 0; r < NB_RULES; r++) {
+    propagated += s->propagated[r];
+  }
+  fprintf(output, "Search nodes: %llu\n", (unsigned long long)s->nodes);
+  fprintf(output, "Choices: %llu\n", (unsigned long long)s->choices);
+  fprintf(output, "Backtracks: %llu\n", (unsigned long long)s->backtracks);
+  fprintf(output, "Conflicts: %llu\n", (unsigned long long)s->conflicts);
+  fprintf(output, "Consistency checks: %llu\n",
+          (unsigned long long)s->checks);
+  fprintf(output, "Maximum depth: %d\n", s->max_depth);
+  fprintf(output, "Propagated cells: %llu (", (unsigned long long)propagated);
+  for (int r = 0; r < NB_RULES; r++) {
+    fprintf(output, "%s%s: %llu", r > 0 ? ", " : "", rule_names[r],
+            (unsigned long long)s->propagated[r]);
+  }
+  fprintf(output, ")\n");
+  fprintf(output, "Grid allocations: %llu (heap: %llu)\n",
+          (unsigned long long)s->grid_allocs,
+          (unsigned long long)s->heap_allocs);
+  fprintf(output, "Time (s):");
+  for (int p = 0; p < NB_PHASES; p++) {
+    fprintf(output, "%s %s %.6f", p > 0 ? "," : "", phase_names[p],
+            s->time[p]);
+  }
+  fprintf(output, "\n");
+}
+
+static void print_json(FILE *output, const t_stats *s) {
+  fprintf(output,
+          "{\"nodes\": %llu, \"choices\": %llu, \"backtracks\": %llu, "
+          "\"conflicts\": %llu, \"checks\": %llu, \"max_depth\": %d, "
+          "\"propagated\": {",
+          (unsigned long long)s->nodes, (unsigned long long)s->choices,
+          (unsigned long long)s->backtracks, (unsigned long long)s->conflicts,
+          (unsigned long long)s->checks, s->max_depth);
+  for (int r = 0; r < NB_RULES; r++) {
+    fprintf(output, "%s\"%s\": %llu", r > 0 ? ", " : "", rule_names[r],
+            (unsigned long long)s->propagated[r]);
+  }
+  fprintf(output, "}, \"grid_allocs\": %llu, \"heap_allocs\": %llu, "
+                  "\"time_s\": {",
+          (unsigned long long)s->grid_allocs,
+          (unsigned long long)s->heap_allocs);
+  for (int p = 0; p < NB_PHASES; p++) {
+    fprintf(output, "%s\"%s\": %.6f", p > 0 ? ", " : "", phase_names[p],
+            s->time[p]);
+  }
+  fprintf(output, "}}\n");
+}
+
+void stats_print(FILE *output, bool json) {
+  stats_flush();
+  if (json) {
+    print_json(output, &total_stats);
+  } else {
+    print_text(output, &total_stats);
+  }
+}
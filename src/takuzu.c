@@ -1,7 +1,163 @@
 #include "../include/takuzu.h"
+#include "../include/batch.h"
+#include "../include/binformat.h"
+#include "../include/generator.h"
 #include "../include/grid.h"
+#include "../include/parallel.h"
+#include "../include/portfolio.h"
+#include "../include/stats.h"
 #include "../include/utility.h"
 #include <stdio.h>
+#include <string.h>
+
+// Parse the input grid, exiting with a message when it cannot be read
+static void read_grid(t_grid *grid, const char *filename) {
+  int error_line;
+  t_parse_status status = file_parser(grid, filename, &error_line);
+
+  if (status == PARSE_IO_ERROR) {
+    fprintf(stderr, "Error opening file: '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  } else if (status != PARSE_OK) {
+    fprintf(stderr, "Error: line %d of '%s': %s\n", error_line, filename,
+            parse_status_message(status));
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Solve every grid of a file holding several of them
+static int solve_batch(char *filename, FILE *output,
+                       globalVariables *variables) {
+  if (variables->all) {
+    fprintf(stderr, "takuzu: warning: option 'all' is ignored in batch mode, "
+                    "use 'count'\n");
+  }
+  if (variables->portfolio) {
+    fprintf(stderr, "takuzu: warning: option 'portfolio' is ignored in batch "
+                    "mode\n");
+  }
+  t_batch_options options = {variables->jobs,
+                             variables->cdcl ? ENGINE_CDCL : ENGINE_DPLL,
+                             variables->count, variables->limit};
+  double start = stats_clock();
+  int nb_invalid = grid_solver_batch(filename, output, &options);
+  stats_time(PHASE_SEARCH, start);
+  return nb_invalid;
+}
+
+// Count the solutions, up to the limit when one is given
+static void solve_count(t_grid *grid, FILE *output,
+                        globalVariables *variables) {
+  if (variables->jobs > 1) {
+    fprintf(stderr, "takuzu: warning: option 'jobs' is ignored when "
+                    "counting\n");
+  }
+  double start = stats_clock();
+  int nb_solutions = grid_count_solutions(grid, variables->limit);
+  stats_time(PHASE_SEARCH, start);
+  grid_solutions_summary(nb_solutions, output);
+  if (variables->limit > 0 && nb_solutions >= variables->limit) {
+    fprintf(output, "Counting stopped at the limit of %d solutions\n",
+            variables->limit);
+  }
+}
+
+// Search all the solutions, with worker threads when several jobs are asked
+static void solve_all(t_grid *grid, FILE *output, globalVariables *variables) {
+  if (variables->count) {
+    solve_count(grid, output, variables);
+    return;
+  }
+  if (variables->cdcl) {
+    fprintf(stderr, "takuzu: warning: engine 'cdcl' only searches for a first "
+                    "solution, using 'dpll'\n");
+  }
+  if (variables->binary && variables->jobs > 1) {
+    fprintf(stderr, "takuzu: warning: option 'jobs' is ignored with the "
+                    "binary format\n");
+  }
+  double start = stats_clock();
+  if (variables->binary) {
+    grid_solver(grid, MODE_ALL, ENGINE_DPLL, output, FORMAT_BIN,
+                variables->output_thread, variables->verbose);
+  } else if (variables->jobs > 1) {
+    if (variables->verbose) {
+      fprintf(stderr, "takuzu: warning: option 'verbose' is ignored with "
+                      "several jobs\n");
+    }
+    grid_solver_parallel(grid, output, variables->jobs, variables->ordered);
+  } else {
+    grid_solver(grid, MODE_ALL, ENGINE_DPLL, output, FORMAT_TEXT,
+                variables->output_thread, variables->verbose);
+  }
+  stats_time(PHASE_SEARCH, start);
+}
+
+// Search a first solution, racing several searches in portfolio mode
+static void solve_first(t_grid *grid, FILE *output,
+                        globalVariables *variables) {
+  double start = stats_clock();
+  if (variables->portfolio) {
+    if (variables->cdcl) {
+      fprintf(stderr, "takuzu: warning: option 'engine' is ignored in "
+                      "portfolio mode\n");
+    }
+    int jobs = variables->jobs > 1 ? variables->jobs : PORTFOLIO_DEFAULT_JOBS;
+    grid_solver_portfolio(grid, output, jobs);
+  } else {
+    grid_solver(grid, MODE_FIRST, variables->cdcl ? ENGINE_CDCL : ENGINE_DPLL,
+                output, FORMAT_TEXT, false, variables->verbose);
+  }
+  stats_time(PHASE_SEARCH, start);
+}
+
+// Write the solutions of a binary file as text
+static void decode_solutions(const char *filename, FILE *output) {
+  t_input input;
+  if (!input_open(&input, filename)) {
+    fprintf(stderr, "Error opening file: '%s'\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  int nb_solutions = bin_decode(input.text, input.length, output);
+  input_close(&input);
+  if (nb_solutions < 0) {
+    fprintf(stderr, "Error: '%s' is not a valid binary file of solutions\n",
+            filename);
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Generate many grids in the batch format, grid k with the seed plus k
+static void generate_batch(globalVariables *variables) {
+  t_generator_options options;
+  options.size = variables->generate_size;
+  options.unique = variables->unique;
+  options.count = variables->generate_count;
+  options.jobs = variables->jobs;
+  options.seed = variables->seeded ? variables->seed : rng_fresh_seed();
+  options.verbose = variables->verbose;
+
+  if (variables->output) {
+    FILE *file = fopen(variables->output_file, "w");
+
+    if (file == NULL) {
+      perror("takuzu: error opening the output file\n");
+      exit(EXIT_FAILURE);
+    }
+    printf("Output is redirected to the file %s\n", variables->output_file);
+    grid_generator_batch(file, &options);
+
+    if (fclose(file) != 0) {
+      perror("error closing the output file\n");
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    grid_generator_batch(stdout, &options);
+  }
+  if (variables->stats) {
+    stats_print(stderr, variables->stats_json);
+  }
+}
 
 int main(int argc, char *argv[]) {
 
@@ -12,9 +168,24 @@ int main(int argc, char *argv[]) {
   variables.output = false;
   variables.generate_mode = false;
   variables.verbose = false;
-
-  while ((variables.opt =
-              getopt_long(argc, argv, "hvaug::o:", long_options, NULL)) != -1) {
+  variables.jobs = 0;
+  variables.ordered = false;
+  variables.portfolio = false;
+  variables.cdcl = false;
+  variables.count = false;
+  variables.generate_count = 0;
+  variables.limit = 0;
+  variables.batch = false;
+  variables.output_thread = false;
+  variables.binary = false;
+  variables.decode_file = NULL;
+  variables.stats = false;
+  variables.stats_json = false;
+  variables.seeded = false;
+  variables.seed = 0;
+
+  while ((variables.opt = getopt_long(argc, argv, "hvaug::o:j:", long_options,
+                                      NULL)) != -1) {
 
     switch (variables.opt) {
     case 'h':
@@ -60,6 +231,102 @@ int main(int argc, char *argv[]) {
       variables.verbose = true;
       break;
 
+    case 'j':
+      variables.jobs = atoi(optarg);
+      if (variables.jobs < 1) {
+        fprintf(stderr, "Invalid number of jobs '%s'\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+
+    case OPT_ORDERED:
+      variables.ordered = true;
+      break;
+
+    case OPT_PORTFOLIO:
+      variables.portfolio = true;
+      break;
+
+    case OPT_ENGINE:
+      if (strcmp(optarg, "cdcl") == 0) {
+        variables.cdcl = true;
+      } else if (strcmp(optarg, "dpll") == 0) {
+        variables.cdcl = false;
+      } else {
+        fprintf(stderr, "Invalid engine '%s', chose among ( dpll | cdcl )\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+
+    case OPT_COUNT:
+      variables.count = true;
+      if (optarg != NULL) {
+        variables.generate_count = atoi(optarg);
+        if (variables.generate_count < 1) {
+          fprintf(stderr, "Invalid number of grids '%s'\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+      }
+      break;
+
+    case OPT_OUTPUT_THREAD:
+      variables.output_thread = true;
+      break;
+
+    case OPT_FORMAT:
+      if (strcmp(optarg, "bin") == 0) {
+        variables.binary = true;
+      } else if (strcmp(optarg, "text") == 0) {
+        variables.binary = false;
+      } else {
+        fprintf(stderr, "Invalid format '%s', chose among ( text | bin )\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+
+    case OPT_STATS:
+      if (optarg == NULL || strcmp(optarg, "text") == 0) {
+        variables.stats_json = false;
+      } else if (strcmp(optarg, "json") == 0) {
+        variables.stats_json = true;
+      } else {
+        fprintf(stderr, "Invalid statistics format '%s', chose among ( text | "
+                        "json )\n",
+                optarg);
+        exit(EXIT_FAILURE);
+      }
+      variables.stats = true;
+      stats_enabled = true;
+      break;
+
+    case OPT_DECODE:
+      variables.decode_file = optarg;
+      break;
+
+    case OPT_BATCH:
+      variables.batch = true;
+      break;
+
+    case OPT_SEED: {
+      char *end;
+      variables.seed = strtoull(optarg, &end, 10);
+      if (*optarg == '\0' || *optarg == '-' || *end != '\0') {
+        fprintf(stderr, "Invalid seed '%s'\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      variables.seeded = true;
+      break;
+    }
+    case OPT_LIMIT:
+      variables.limit = atoi(optarg);
+      if (variables.limit < 1) {
+        fprintf(stderr, "Invalid limit '%s'\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+
     default:
       fprintf(stderr, "Invalid option\n");
       exit(EXIT_FAILURE);
@@ -70,6 +337,27 @@ int main(int argc, char *argv[]) {
     PrintHelp();
   }
 
+  if (variables.decode_file != NULL) { // decoding of a binary file
+    if (variables.output) {
+      FILE *file = fopen(variables.output_file, "w");
+
+      if (file == NULL) {
+        perror("takuzu: error opening the output file\n");
+        exit(EXIT_FAILURE);
+      }
+      printf("Output is redirecting to the file %s\n", variables.output_file);
+      decode_solutions(variables.decode_file, file);
+
+      if (fclose(file) != 0) {
+        perror("error closing the output file\n");
+        exit(EXIT_FAILURE);
+      }
+    } else {
+      decode_solutions(variables.decode_file, stdout);
+    }
+    return EXIT_SUCCESS;
+  }
+
   if (!variables.generate_mode) { // solver mode
 
     if (variables.unique) {
@@ -79,24 +367,55 @@ int main(int argc, char *argv[]) {
       exit(EXIT_FAILURE);
     }
 
+    if (variables.binary && (!variables.all || variables.count)) {
+      fprintf(stderr, "takuzu: warning: option 'format' is only used with "
+                      "'all', ignoring it\n");
+    }
+
+    if (variables.limit > 0 && !variables.count) {
+      fprintf(stderr, "takuzu: warning: option 'limit' is only used with "
+                      "'count', ignoring it\n");
+    }
+    if (variables.seeded) {
+      fprintf(stderr, "takuzu: warning: option 'seed' is only used with "
+                      "'generate', ignoring it\n");
+    }
+    if (variables.generate_count > 0) {
+      fprintf(stderr, "takuzu: warning: a number of grids is only used with "
+                      "'generate', ignoring it\n");
+    }
+
     if (optind >=
         argc) { // look if there is any arguments left after the options
       fprintf(stderr, "takuzu: error: no input grid given!\n");
       exit(EXIT_FAILURE);
     }
-    if (variables.all) {
-      t_grid grid;
-      char *filename = argv[optind];
-      int verbose = 0;
-      if (variables.verbose) {
-        verbose = 1;
-      }
+    if (variables.batch) {
+      int nb_invalid;
+      if (variables.output) {
+        FILE *file = fopen(variables.output_file, "w");
 
-      file_parser(&grid, filename);
+        if (file == NULL) {
+          perror("takuzu: error opening the output file\n");
+          exit(EXIT_FAILURE);
+        }
+        printf("Output is redirecting to the file %s\n", variables.output_file);
+        nb_invalid = solve_batch(argv[optind], file, &variables);
 
-      t_grid gridCopy;
-      grid_copy(&grid, &gridCopy);
-      file_parser(&grid, filename);
+        if (fclose(file) != 0) {
+          perror("error closing the output file\n");
+          exit(EXIT_FAILURE);
+        }
+      } else {
+        nb_invalid = solve_batch(argv[optind], stdout, &variables);
+      }
+      if (variables.stats) {
+        stats_print(stderr, variables.stats_json);
+      }
+      return nb_invalid > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    } else if (variables.all || variables.count) {
+      t_grid grid;
+      read_grid(&grid, argv[optind]);
       if (variables.output) {
         FILE *file = fopen(variables.output_file, "w");
 
@@ -105,28 +424,18 @@ int main(int argc, char *argv[]) {
           exit(EXIT_FAILURE);
         }
         printf("Output is redirecting to the file %s\n", variables.output_file);
-        grid_solver(&grid, MODE_ALL, file, verbose);
+        solve_all(&grid, file, &variables);
 
         if (fclose(file) != 0) {
           perror("error closing the output file\n");
           exit(EXIT_FAILURE);
         }
       } else {
-        grid_solver(&grid, MODE_ALL, stdout, verbose);
+        solve_all(&grid, stdout, &variables);
       }
     } else {
       t_grid grid;
-      char *filename = argv[optind];
-      int verbose = 0;
-      if (variables.verbose) {
-        verbose = 1;
-      }
-
-      file_parser(&grid, filename);
-
-      t_grid gridCopy;
-      grid_copy(&grid, &gridCopy);
-      file_parser(&grid, filename);
+      read_grid(&grid, argv[optind]);
       if (variables.output) {
         FILE *file = fopen(variables.output_file, "w");
 
@@ -135,14 +444,14 @@ int main(int argc, char *argv[]) {
           exit(EXIT_FAILURE);
         }
         printf("Output is redirecting to the file %s\n", variables.output_file);
-        grid_solver(&grid, MODE_FIRST, file, verbose);
+        solve_first(&grid, file, &variables);
 
         if (fclose(file) != 0) {
           perror("error closing the output file\n");
           exit(EXIT_FAILURE);
         }
       } else {
-        grid_solver(&grid, MODE_FIRST, stdout, verbose);
+        solve_first(&grid, stdout, &variables);
       }
     }
   }
@@ -152,7 +461,7 @@ int main(int argc, char *argv[]) {
       variables.generate_size = 8;
     }
 
-    else {
+    else if (!variables.count) { // the batch output holds only the grids
       printf("grid size = %d x %d \n", variables.generate_size,
              variables.generate_size);
     }
@@ -164,15 +473,40 @@ int main(int argc, char *argv[]) {
       variables.all = 0;
     }
 
+    // --count N: the number may also be the argument after the options
+    if (variables.count && variables.generate_count == 0) {
+      if (optind < argc) {
+        variables.generate_count = atoi(argv[optind++]);
+      }
+      if (variables.generate_count < 1) {
+        fprintf(stderr, "takuzu: error: --count needs a number of grids to "
+                        "generate\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+
     if (optind <
         argc) { // look if there is any arguments left after the options
       fprintf(stderr, "Generation mode: no need to provide a file\n");
       exit(EXIT_FAILURE);
     }
+
+    if (variables.count) {
+      generate_batch(&variables);
+      return EXIT_SUCCESS;
+    }
     int verbose = 0;
     if (variables.verbose) {
       verbose = 1;
     }
+    // The seed is printed in verbose mode so that a grid can be generated
+    // again with --seed
+    t_rng rng;
+    uint64_t seed = variables.seeded ? variables.seed : rng_fresh_seed();
+    rng_seed(&rng, seed);
+    if (verbose) {
+      printf("Seed: %llu\n", (unsigned long long)seed);
+    }
     if (variables.unique) {
       t_grid grid;
       int percentage = 20;
@@ -188,7 +522,7 @@ int main(int argc, char *argv[]) {
         printf("Output is redirected to the file %s\n", variables.output_file);
         fprintf(file, "Generating a solved grid of size %d x %d \n",
                 variables.generate_size, variables.generate_size);
-        generate_grid(variables.generate_size, percentage, &grid, file, 1,
+        generate_grid(variables.generate_size, percentage, &grid, 1, &rng,
                       verbose);
         grid_print(&grid, file);
         if (fclose(file) != 0) {
@@ -196,7 +530,7 @@ int main(int argc, char *argv[]) {
           exit(EXIT_FAILURE);
         }
       } else {
-        generate_grid(variables.generate_size, percentage, &grid, stdout, 1,
+        generate_grid(variables.generate_size, percentage, &grid, 1, &rng,
                       verbose);
         fprintf(stdout, "Grid of size %d x %d generated !!!\n",
                 variables.generate_size, variables.generate_size);
@@ -214,7 +548,7 @@ int main(int argc, char *argv[]) {
           perror("takuzu: error opening the output file\n");
           exit(EXIT_FAILURE);
         }
-        generate_grid(variables.generate_size, percentage, &g, file, 0,
+        generate_grid(variables.generate_size, percentage, &g, 0, &rng,
                       verbose);
         printf("Output is redirected to the file %s\n", variables.output_file);
         fprintf(file, "Grid of size %d x %d generated !!!\n",
@@ -227,7 +561,7 @@ int main(int argc, char *argv[]) {
       } else {
         fprintf(stdout, "Generating a grid of size %d x %d ...\n\n",
                 variables.generate_size, variables.generate_size);
-        generate_grid(variables.generate_size, percentage, &g, stdout, 0,
+        generate_grid(variables.generate_size, percentage, &g, 0, &rng,
                       verbose);
         fprintf(stdout, "Grid of size %d x %d generated !!!\n",
                 variables.generate_size, variables.generate_size);
@@ -235,5 +569,8 @@ int main(int argc, char *argv[]) {
       }
     }
   }
+  if (variables.stats) {
+    stats_print(stderr, variables.stats_json);
+  }
   return 0;
 }
\ No newline at end of file
@@ -1,238 +1,377 @@
+#define _POSIX_C_SOURCE 200809L
 #include "../include/utility.h"
+#include "../include/bitboard.h"
+#include "../include/stats.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 void PrintHelp() {
 
-  printf("Usage: takuzu [-a|-o FILE|-v|-h] FILE...\n"
-         "takuzu -g[SIZE] [-u|-o FILE|-v|-h]\n"
+  printf("Usage: takuzu [-a [-j N] [--ordered] [--output-thread] "
+         "[--format=FORMAT]|--count [--limit K]|--portfolio [-j N]|"
+         "--engine=ENGINE|-o FILE|--stats|-v|-h] FILE...\n"
+         "takuzu --batch [-j N] [--count [--limit K]|--engine=ENGINE|"
+         "-o FILE|--stats] FILE\n"
+         "takuzu -g[SIZE] [-u|--seed N|--count N [-j N]|-o FILE|--stats|"
+         "-v|-h]\n"
+         "takuzu --decode FILE [-o FILE]\n"
          "Solve or generate takuzu grids of size: 4, 8, 16, 32, 64\n"
          "-a, --all\tsearch for all possible solutions\n"
+         "--batch\tsolve every grid of FILE, grids are separated by blank "
+         "or comment lines (default N: number of cores)\n"
+         "--count\tonly print the number of solutions\n"
+         "--count N\twith -g, generate N grids in the --batch format with "
+         "N threads of -j (default: number of cores), grid k with seed N+k\n"
+         "--decode FILE\twrite the solutions of a binary FILE as text\n"
+         "--format=FORMAT\twith -a, format of the solutions: text (default) "
+         "or bin, compact binary\n"
+         "--limit K\twith --count, stop counting at K solutions\n"
          "-g[N], --generate[=N]\tgenerate a grid of size NxN (default: 8)\n"
+         "-j N, --jobs N\tsearch all solutions with N threads (default: 1)\n"
+         "--ordered\twith -j, print the solutions in the sequential order\n"
+         "--output-thread\twith -a, write the solutions from a background "
+         "thread\n"
+         "--portfolio\trace N differently configured searches for the first "
+         "solution (default N: 4)\n"
+         "--engine=ENGINE\tsearch engine for the first solution: dpll "
+         "(default) or cdcl, clause learning for large grids\n"
          "-o FILE, --output FILE\twrite output to FILE\n"
+         "--stats[=FORMAT]\tprint search statistics on stderr: text "
+         "(default) or json\n"
+         "--seed N\twith -g, seed of the random draws: a seed always gives "
+         "the same grid (default: a new seed at each run)\n"
          "-u, --unique\tgenerate a grid with a unique solution\n"
          "-v, --verbose\tverbose output\n"
          "-h, --help\tdisplay this help and exit\n");
   exit(EXIT_SUCCESS);
 };
 
-void grid_allocate(t_grid *g, int size) {
+// Grid buffers are recycled through one free list per grid size (4, 8, 16,
+// 32 and 64), so that the search and the generation do not go back to the
+// heap for every grid. The cached buffers are given back to the heap in one
+// step by grid_pool_release. The free lists and the counters are per thread,
+// a worker thread releases its own pool before exiting.
+#define GRID_POOL_CLASSES 5
 
-  g->size = size;
-  g->grid = (char *)malloc(size * size * sizeof(char));
+typedef struct pool_buffer {
+  struct pool_buffer *next;
+} pool_buffer;
 
-  if (g->grid == NULL) {
-    fprintf(stderr, "Error: Memory allocation failed for the grid.\n");
-    exit(EXIT_FAILURE);
+static _Thread_local pool_buffer *grid_pool[GRID_POOL_CLASSES];
+static _Thread_local t_grid_pool_stats grid_pool_stats;
+
+// Index of the free list of a grid size, -1 if the size has no free list
+static int pool_class(int size) {
+  if (size < 4 || size > 64 || (size & (size - 1)) != 0) {
+    return -1;
   }
+  return __builtin_ctz(size) - 2;
+}
 
-  for (int i = 0; i < (size * size); i++) {
+// A buffer holds the masks and the sets followed by the room of the trail
+static size_t grid_buffer_size(int size) {
+  return GRID_WORDS(size) * sizeof(uint64_t) + size * size * sizeof(int);
+}
 
-    g->grid[i] = '_';
+void grid_pool_release(void) {
+  for (int c = 0; c < GRID_POOL_CLASSES; c++) {
+    while (grid_pool[c] != NULL) {
+      pool_buffer *buffer = grid_pool[c];
+      grid_pool[c] = buffer->next;
+      free(buffer);
+      grid_pool_stats.heap_frees++;
+    }
   }
 }
 
-void grid_free(t_grid *g) {
+t_grid_pool_stats grid_pool_get_stats(void) { return grid_pool_stats; }
 
-  free(g->grid);
-  g->grid = NULL;
-  g->size = 0;
+void grid_pool_print_stats(FILE *fd) {
+  fprintf(fd,
+          "Grid buffers: %ld heap allocations, %ld heap frees, %ld reused "
+          "from the pool\n",
+          grid_pool_stats.heap_allocs, grid_pool_stats.heap_frees,
+          grid_pool_stats.reused);
 }
 
-bool check_char(const char c) { return (c == '0') || (c == '1') || (c == '_'); }
-
-void grid_print(t_grid *g, FILE *fd) {
+void grid_allocate(t_grid *g, int size) {
 
-  int n = g->size;
-  for (int i = 0; i < (g->size * g->size); i++) {
-    if (n == 0) {
-      fprintf(fd, "\n");
-      n = g->size;
-    }
-    fprintf(fd, "%c ", g->grid[i]);
-    n--;
+  g->size = size;
+  uint64_t *masks;
+  int c = pool_class(size);
+
+  if (c >= 0 && grid_pool[c] != NULL) {
+    masks = (uint64_t *)grid_pool[c];
+    grid_pool[c] = grid_pool[c]->next;
+    grid_pool_stats.reused++;
+    memset(masks, 0, GRID_WORDS(size) * sizeof(uint64_t));
+  } else {
+    masks = (uint64_t *)calloc(1, grid_buffer_size(size));
+    grid_pool_stats.heap_allocs++;
+    thread_stats.heap_allocs++;
   }
-  fprintf(fd, "\n");
-}
+  thread_stats.grid_allocs++;
 
-static int get_size(FILE *file, char *filename) {
-  int size = 0;
-  int line = 1;
-  char ch;
-  int isFirstChar = 1; // Flag to track the first character of the line (when #
-  // is first char of the line)
-
-  while ((ch = fgetc(file)) != EOF) {
-    if (isFirstChar && ch == '#') {
-      while ((ch = fgetc(file)) != EOF && ch != '\n') {
-        ; // do nothing
-      }
+  // Every mask starts at zero, that is to say every cell is empty
+  if (masks == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the grid.\n");
+    exit(EXIT_FAILURE);
+  }
 
-      line++;
+  g->row_ones = masks;
+  g->row_filled = masks + size;
+  g->col_ones = masks + 2 * size;
+  g->col_filled = masks + 3 * size;
+  g->full_rows = masks + 4 * size;
+  g->full_cols = masks + 8 * size;
+  g->rows_bad = 0;
+  g->cols_bad = 0;
+  g->dup_lines = 0;
+  g->empty_cells = size * size;
+  g->dirty_rows = 0;
+  g->dirty_cols = 0;
+  g->trail = NULL;
+  g->trail_len = 0;
+}
 
-      isFirstChar = 1; // Reset the flag for the next line
-      continue;
-    }
+void grid_free(t_grid *g) {
 
-    else if ((!isFirstChar) && ch == '#') {
-      break;
+  if (g->row_ones != NULL) {
+    int c = pool_class(g->size);
+    if (c >= 0) {
+      // The buffer goes back to the free list of its size
+      pool_buffer *buffer = (pool_buffer *)g->row_ones;
+      buffer->next = grid_pool[c];
+      grid_pool[c] = buffer;
+    } else {
+      free(g->row_ones);
+      grid_pool_stats.heap_frees++;
     }
-    if (ch == ' ' || ch == '\t' || ch == '\n') {
+  }
+  g->trail = NULL;
+  g->trail_len = 0;
+  g->row_ones = NULL;
+  g->row_filled = NULL;
+  g->col_ones = NULL;
+  g->col_filled = NULL;
+  g->full_rows = NULL;
+  g->full_cols = NULL;
+  g->size = 0;
+}
 
-      continue;
+bool check_char(const char c) { return (c == '0') || (c == '1') || (c == '_'); }
 
+size_t grid_render(const t_grid *g, char *buffer) {
+  char *p = buffer;
+  for (int i = 0; i < g->size; i++) {
+    uint64_t ones = g->row_ones[i];
+    uint64_t filled = g->row_filled[i];
+    for (int j = 0; j < g->size; j++) {
+      *p++ = ((filled >> j) & 1) ? (char)('0' + ((ones >> j) & 1)) : '_';
+      *p++ = ' ';
     }
+    *p++ = '\n';
+  }
+  return p - buffer;
+}
 
-    else if (check_char(ch)) {
-      size++;
-      isFirstChar = 0; // Not the first character anymore
-      ch = fgetc(file);
-
-      if (ch == ' ' || ch == '\t') {
+void grid_print(t_grid *g, FILE *fd) {
+  char buffer[GRID_TEXT_SIZE(64)];
+  fwrite(buffer, 1, grid_render(g, buffer), fd);
+}
 
-        while ((ch = fgetc(file)) == ' ' || ch == '\t')
-          ;
+// Slurp a stream which cannot be mapped (standard input, pipes)
+static bool input_slurp(t_input *input, int fd) {
+  size_t capacity = 1 << 16;
+  char *text = (char *)malloc(capacity);
+  ssize_t n;
+
+  input->length = 0;
+  while (text != NULL &&
+         (n = read(fd, text + input->length, capacity - input->length)) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
       }
-
-      if (ch == '\n' || ch == '#') {
-
-        break;
-      } else {
-        ungetc(ch, file); // Put back non-newline char
+      free(text);
+      return false;
+    }
+    input->length += n;
+    if (input->length == capacity) {
+      capacity *= 2;
+      char *bigger = (char *)realloc(text, capacity);
+      if (bigger == NULL) {
+        free(text);
       }
+      text = bigger;
+    }
+  }
+  input->text = text;
+  input->mapped = false;
+  return text != NULL;
+}
 
-    } else {
-      fprintf(stderr, "Error: wrong character '%c' at line %d of the file!\n",
-              ch, line);
-      if (fclose(file) != 0) {
+bool input_open(t_input *input, const char *filename) {
+  bool from_stdin = strcmp(filename, "-") == 0;
+  int fd = from_stdin ? STDIN_FILENO : open(filename, O_RDONLY);
+  struct stat st;
+  bool ok;
 
-        fprintf(stderr, "Error closing file: '%s'\n", filename);
-      }
-      exit(EXIT_FAILURE);
+  if (fd < 0) {
+    return false;
+  }
+  // Regular files are mapped read only, nothing is copied
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ok = text != MAP_FAILED;
+    if (ok) {
+      input->text = (const char *)text;
+      input->length = st.st_size;
+      input->mapped = true;
     }
+  } else {
+    ok = input_slurp(input, fd);
+  }
+  if (!from_stdin) {
+    close(fd);
   }
+  return ok;
+}
 
-  if (size != 4 && size != 8 && size != 16 && size != 32 && size != 64) {
-    fprintf(stderr,
-            "Invalid grid size argument. Please chose a grid size among ( "
-            "4 | 8 | 16 | 32 | 64 )\n");
-    exit(EXIT_FAILURE);
+void input_close(t_input *input) {
+  if (input->mapped) {
+    munmap((void *)input->text, input->length);
+  } else {
+    free((void *)input->text);
   }
+  input->text = NULL;
+  input->length = 0;
+}
 
-  rewind(file);
+t_parse_status file_parser(t_grid *grid, const char *filename,
+                           int *error_line) {
+  t_input input;
 
-  return size;
+  if (!input_open(&input, filename)) {
+    return PARSE_IO_ERROR;
+  }
+  t_parse_status status =
+      grid_parse(grid, input.text, input.length, error_line);
+  input_close(&input);
+  return status;
 }
 
-void file_parser(t_grid *grid, char *filename) {
-
+// Parse a grid from a text in memory, in one pass: the size is given by the
+// first row, the cells are gathered in the masks of the rows and the grid is
+// set at once from them (see bb_load) when the whole text is read. Lines
+// starting with '#' are comments, so is the end of a row after a '#', blank
+// lines are skipped. The grid is allocated only when PARSE_OK is returned,
+// otherwise error_line (when not NULL) gets the line of the error.
+static t_parse_status parse_text(t_grid *grid, const char *text,
+                                 size_t length, int *error_line) {
+  uint64_t ones[64] = {0};
+  uint64_t filled[64] = {0};
   int size = 0;
   int row = 0;
-  int col = 0;
   int line = 1;
-  int i = 0;
-  char ch;
-
-  FILE *file = fopen(filename, "r+");
-  if (file == NULL) {
-    fprintf(stderr, "Error opening file: '%s'\n", filename);
-    exit(EXIT_FAILURE);
-  }
-  fseek(file, 0, SEEK_END);
-  fprintf(file, "\n");
-  fseek(file, 0, SEEK_SET);
-  size = get_size(file, filename);
-  grid_allocate(grid, size);
-
-  while ((ch = fgetc(file)) != EOF) {
-
-    if (ch == '\n') {
-      line++;
-
-      continue;
-    } else if (ch == '#') {
-      // Ignore comment lines
-      while ((ch = fgetc(file)) != EOF && ch != '\n')
-        ;
-
-      if (ch == EOF) {
+  t_parse_status status = PARSE_OK;
+  size_t k = 0;
+
+  while (k < length && status == PARSE_OK) {
+    int col = 0;
+    // One line of the text: cells up to the end of line or a comment
+    for (; k < length && text[k] != '\n' && text[k] != '#'; k++) {
+      char ch = text[k];
+      if (ch == ' ' || ch == '\t' || ch == '\r') {
+        continue;
+      }
+      if (!check_char(ch)) {
+        status = PARSE_BAD_CHAR;
         break;
       }
-
-    } else if (ch == ' ' || ch == '\t') {
-
-      continue;
-
-    }
-
-    else if (check_char(ch)) {
-
-      grid->grid[i] = ch;
-      col++;
-      i++;
-
-      ch = fgetc(file);
-
-      if (ch == ' ' || ch == '\t') {
-
-        while ((ch = fgetc(file)) == ' ' || ch == '\t')
-          ;
+      if (row == 0 && col == 64) {
+        status = PARSE_BAD_SIZE;
+        break;
       }
-
-      if (ch == '\n' || ch == '#') {
-        ungetc(ch, file); // Put back non-newline char
-
-        if (col != size) {
-
-          fprintf(stderr,
-                  "Error: line %d is malformed (wrong number of columns)\n",
-                  row + 1);
-          grid_free(grid);
-          if (fclose(file) != 0) {
-
-            fprintf(stderr, "Error closing file: '%s'\n", filename);
-          }
-
-          exit(EXIT_FAILURE);
-        }
-        row++;
-        line++;
-        col = 0;
-      } else {
-        ungetc(ch, file); // Put back non-newline char
+      if ((row == 0 || (row < size && col < size)) && ch != '_') {
+        filled[row] |= 1ULL << col;
+        ones[row] |= (uint64_t)(ch == '1') << col;
       }
+      col++;
+    }
+    if (status != PARSE_OK) {
+      break;
+    }
+    while (k < length && text[k] != '\n') {
+      k++;
+    }
 
-    } else {
-      fprintf(stderr, "Error: wrong character '%c' at line %d of the file!\n",
-              ch, line);
-      grid_free(grid);
-      if (fclose(file) != 0) {
-
-        fprintf(stderr, "Error closing file: '%s'\n", filename);
+    if (col > 0) {
+      if (row == 0) {
+        size = col;
+        if (size != 4 && size != 8 && size != 16 && size != 32 && size != 64) {
+          status = PARSE_BAD_SIZE;
+          break;
+        }
+      } else if (col != size) {
+        status = PARSE_BAD_ROW;
+      } else if (row >= size) {
+        status = PARSE_BAD_LINES;
       }
-      exit(EXIT_FAILURE);
+      row++;
     }
-  }
-
-  if (row != size) {
-    if (row < size) {
-      fprintf(stderr, "Error: grid has %d missing lines!\n", size - row);
-    } else {
-      fprintf(stderr, "Error: grid has %d added lines!\n", row - size);
+    if (status == PARSE_OK && k < length) {
+      k++; // end of line
+      line++;
     }
-    grid_free(grid);
-    if (fclose(file) != 0) {
+  }
 
-      fprintf(stderr, "Error closing file: '%s'\n", filename);
-    }
-    exit(EXIT_FAILURE);
+  if (status == PARSE_OK && row == 0) {
+    status = PARSE_EMPTY;
+  } else if (status == PARSE_OK && row != size) {
+    status = PARSE_BAD_LINES;
+  }
+  if (status == PARSE_OK) {
+    grid_allocate(grid, size);
+    bb_load(grid, ones, filled);
+  } else if (error_line != NULL) {
+    *error_line = line;
   }
+  return status;
+}
 
-  if (fclose(file) != 0) {
+t_parse_status grid_parse(t_grid *grid, const char *text, size_t length,
+                          int *error_line) {
+  double start = stats_clock();
+  t_parse_status status = parse_text(grid, text, length, error_line);
+  stats_time(PHASE_PARSE, start);
+  return status;
+}
 
-    fprintf(stderr, "Error closing file: '%s'\n", filename);
-    exit(EXIT_FAILURE);
+const char *parse_status_message(t_parse_status status) {
+  switch (status) {
+  case PARSE_OK:
+    return "no error";
+  case PARSE_IO_ERROR:
+    return "cannot read the file";
+  case PARSE_EMPTY:
+    return "no grid found";
+  case PARSE_BAD_CHAR:
+    return "wrong character";
+  case PARSE_BAD_SIZE:
+    return "invalid grid size, chose among ( 4 | 8 | 16 | 32 | 64 )";
+  case PARSE_BAD_ROW:
+    return "wrong number of columns";
+  case PARSE_BAD_LINES:
+    return "the grid does not have as many lines as columns";
   }
-}
\ No newline at end of file
+  return "unknown error";
+}
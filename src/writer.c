@@ -0,0 +1,142 @@
+#include "../include/writer.h"
+#include "../include/stats.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Two buffers: the caller fills the current one, the other one is handed to
+// the background thread when the current one is full. Without a thread the
+// full buffer is written by the caller.
+struct t_writer {
+  FILE *output;
+  char *buffers[2];
+  int current;
+  size_t length; // Characters in the current buffer
+  bool background;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  size_t pending; // Characters of the other buffer to write, 0 when done
+  bool closing;
+};
+
+static void *writer_main(void *arg) {
+  t_writer *writer = (t_writer *)arg;
+
+  pthread_mutex_lock(&writer->lock);
+  for (;;) {
+    while (writer->pending == 0 && !writer->closing) {
+      pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    if (writer->pending == 0) {
+      break;
+    }
+    const char *block = writer->buffers[1 - writer->current];
+    size_t length = writer->pending;
+    pthread_mutex_unlock(&writer->lock);
+    double start = stats_clock();
+    fwrite(block, 1, length, writer->output);
+    stats_time(PHASE_OUTPUT, start);
+    pthread_mutex_lock(&writer->lock);
+    writer->pending = 0;
+    pthread_cond_broadcast(&writer->changed);
+  }
+  pthread_mutex_unlock(&writer->lock);
+  stats_flush();
+  return NULL;
+}
+
+// Write the current buffer out, or give it to the thread once it is done
+// with the previous one
+static void writer_flush(t_writer *writer) {
+  if (writer->length == 0) {
+    return;
+  }
+  if (!writer->background) {
+    double start = stats_clock();
+    fwrite(writer->buffers[0], 1, writer->length, writer->output);
+    stats_time(PHASE_OUTPUT, start);
+    writer->length = 0;
+    return;
+  }
+  pthread_mutex_lock(&writer->lock);
+  while (writer->pending != 0) {
+    pthread_cond_wait(&writer->changed, &writer->lock);
+  }
+  writer->pending = writer->length;
+  writer->current = 1 - writer->current;
+  writer->length = 0;
+  pthread_cond_broadcast(&writer->changed);
+  pthread_mutex_unlock(&writer->lock);
+}
+
+t_writer *writer_open(FILE *output, bool background) {
+  t_writer *writer = (t_writer *)malloc(sizeof(t_writer));
+  int nb_buffers = background ? 2 : 1;
+
+  if (writer == NULL) {
+    fprintf(stderr, "Error: Memory allocation failed for the writer.\n");
+    exit(EXIT_FAILURE);
+  }
+  writer->output = output;
+  writer->buffers[1] = NULL;
+  for (int b = 0; b < nb_buffers; b++) {
+    writer->buffers[b] = (char *)malloc(WRITER_BUFFER_SIZE);
+    if (writer->buffers[b] == NULL) {
+      fprintf(stderr, "Error: Memory allocation failed for the writer.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  writer->current = 0;
+  writer->length = 0;
+  writer->background = background;
+  writer->pending = 0;
+  writer->closing = false;
+  if (background) {
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+      fprintf(stderr, "Error: cannot create the writer thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return writer;
+}
+
+char *writer_reserve(t_writer *writer, size_t length) {
+  if (writer->length + length > WRITER_BUFFER_SIZE) {
+    writer_flush(writer);
+  }
+  return writer->buffers[writer->current] + writer->length;
+}
+
+void writer_commit(t_writer *writer, size_t length) {
+  writer->length += length;
+}
+
+void writer_write(t_writer *writer, const char *text, size_t length) {
+  while (length > 0) {
+    size_t chunk = length < WRITER_BUFFER_SIZE ? length : WRITER_BUFFER_SIZE;
+    memcpy(writer_reserve(writer, chunk), text, chunk);
+    writer_commit(writer, chunk);
+    text += chunk;
+    length -= chunk;
+  }
+}
+
+void writer_close(t_writer *writer) {
+  writer_flush(writer);
+  if (writer->background) {
+    pthread_mutex_lock(&writer->lock);
+    writer->closing = true;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->changed);
+  }
+  fflush(writer->output);
+  free(writer->buffers[0]);
+  free(writer->buffers[1]);
+  free(writer);
+}